@@ -0,0 +1,20 @@
+// decoding of the compact vertex format (see VertexQuantization.hpp), 
+// uniforms are set by Shader::setBuffers (identity for float vertexes)
+uniform vec3 vertexPositionScale, vertexPositionOffset;
+uniform vec2 vertexTexCoordsScale, vertexTexCoordsOffset;
+uniform bool vertexNormalOctahedral;
+
+vec3 decodePosition(vec3 p) {
+	return vertexPositionOffset + vertexPositionScale*p;
+}
+
+vec3 decodeNormal(vec3 n) {
+	if (!vertexNormalOctahedral) return n;
+	vec3 r = vec3(n.xy, 1.f-abs(n.x)-abs(n.y));
+	if (r.z<0.f) r.xy = (1.f-abs(r.yx)) * vec2(r.x<0.f?-1.f:1.f, r.y<0.f?-1.f:1.f);
+	return normalize(r);
+}
+
+vec2 decodeTexCoords(vec2 tc) {
+	return vertexTexCoordsOffset + vertexTexCoordsScale*tc;
+}
@@ -2,21 +2,24 @@
 
 in vec3 vertexPosition;
 in vec3 vertexNormal;
+in mat4 instanceMatrix; // identity if not instanced (see Shader::setBuffers)
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+uniform mat3 normalMatrix; // inverse transpose of view*model (see Shader::setModelMatrix)
+
+#include "funcs/uniformBlocks.glsl"
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec4 lightVSPosition;
 
+#include "funcs/vertexDecode.vert"
+
 void main() {
-	mat4 vm = viewMatrix * modelMatrix;
-	vec4 vmp = vm * vec4(vertexPosition,1.f);
+	mat4 vm = viewMatrix * modelMatrix * instanceMatrix;
+	vec4 vmp = vm * vec4(decodePosition(vertexPosition),1.f);
 	fragPosition = vec3(vmp);
 	gl_Position = projectionMatrix * vmp;
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
+	fragNormal = normalMatrix * mat3(instanceMatrix) * decodeNormal(vertexNormal); // (instances must not have non-uniform scales)
 	lightVSPosition = viewMatrix * lightPosition;
 }
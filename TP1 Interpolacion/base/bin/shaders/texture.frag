@@ -5,14 +5,9 @@ in vec3 fragPosition;
 in vec2 fragTexCoords;
 in vec4 lightVSPosition;
 
-// propiedades del material
+// propiedades del material y de la luz
 uniform sampler2D colorTexture; // ambient and diffuse components
-uniform vec3 specularColor;
-uniform float shininess;
-
-// propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+#include "funcs/uniformBlocks.glsl"
 
 out vec4 fragColor;
 
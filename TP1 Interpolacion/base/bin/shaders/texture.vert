@@ -5,21 +5,23 @@ in vec3 vertexNormal;
 in vec2 vertexTexCoords;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+uniform mat3 normalMatrix; // inverse transpose of view*model (see Shader::setModelMatrix)
+
+#include "funcs/uniformBlocks.glsl"
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexCoords;
 out vec4 lightVSPosition;
 
+#include "funcs/vertexDecode.vert"
+
 void main() {
 	mat4 vm = viewMatrix * modelMatrix;
-	vec4 vmp = vm * vec4(vertexPosition,1.f);
+	vec4 vmp = vm * vec4(decodePosition(vertexPosition),1.f);
 	gl_Position = projectionMatrix * vmp;
 	fragPosition = vec3(vmp);
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
+	fragNormal = normalMatrix * decodeNormal(vertexNormal);
 	lightVSPosition = viewMatrix * lightPosition;
-	fragTexCoords = vertexTexCoords;
+	fragTexCoords = decodeTexCoords(vertexTexCoords);
 }
@@ -0,0 +1,23 @@
+# version 330 core
+
+in vec3 fragNormal;
+in vec3 fragPosition;
+in vec2 fragTexCoords;
+in vec4 lightVSPosition;
+
+// propiedades del material y de la luz
+uniform sampler2DArray colorTextures; // ambient and diffuse components, one layer per image
+#include "funcs/uniformBlocks.glsl"
+
+out vec4 fragColor;
+
+#include "funcs/calcPhong.frag"
+
+void main() {
+	
+	vec4 tex = texture(colorTextures,vec3(fragTexCoords,textureLayer)); // (layer from the Material block)
+	vec3 phong = calcPhong(lightVSPosition, lightColor,
+						   vec3(tex), vec3(tex), specularColor, shininess);
+	fragColor = vec4(phong,tex.a);
+}
+
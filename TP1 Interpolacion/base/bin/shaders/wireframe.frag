@@ -1,8 +1,7 @@
 # version 330 core
 
 // propiedades del material
-uniform vec3 diffuseColor;
-uniform float opacity;
+#include "funcs/uniformBlocks.glsl"
 
 in float colorDecay;
 
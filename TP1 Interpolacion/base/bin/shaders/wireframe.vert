@@ -4,13 +4,16 @@ in vec3 vertexPosition;
 in vec3 vertexNormal;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+uniform mat3 normalMatrix; // inverse transpose of view*model (see Shader::setModelMatrix)
+
+#include "funcs/uniformBlocks.glsl"
 
 out float colorDecay;
 
+#include "funcs/vertexDecode.vert"
+
 void main() {
-	vec3 fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	vec3 fragNormal = normalMatrix * decodeNormal(vertexNormal);
 	colorDecay = fragNormal.z<0.f ? .75f : 1.f;
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(decodePosition(vertexPosition),1.f);
 }
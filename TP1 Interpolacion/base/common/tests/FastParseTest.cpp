@@ -0,0 +1,170 @@
+// Checks that parseFloat/parseInt (FastParse.hpp) give exactly the same
+// values than strtof/strtol, and stop at the same char, and compares their
+// speed (floats per second) on numbers written like in an .obj. Build and
+// run from this folder with:
+//   g++ -std=c++14 -O2 -I../utils FastParseTest.cpp ../utils/FastParse.cpp -o FastParseTest && ./FastParseTest
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include "FastParse.hpp"
+
+static long checks = 0, failures = 0;
+
+// best of some runs, in seconds
+template<typename F>
+static double bestTime(F f) {
+	double best = 1e30;
+	for(int r=0;r<5;++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best,std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count());
+	}
+	return best;
+}
+
+static void fail(const char *what, const std::string &s) {
+	if (++failures<=20) std::printf("FAIL (%s): \"%s\"\n",what,s.c_str());
+}
+
+// s must be a decimal number (strtof would also parse hex, inf and nan)
+static void checkFloat(const std::string &s) {
+	++checks;
+	const char *p = s.c_str(), *end = p+s.size();
+	float value = 0.f;
+	bool ok = parseFloat(p,end,value);
+	char *s_end; float expected = std::strtof(s.c_str(),&s_end);
+	if (not ok) { if (s_end!=s.c_str()) fail("not parsed",s); return; }
+	if (std::memcmp(&value,&expected,sizeof(float))!=0) fail("value",s);
+	if (p!=s_end) fail("end",s);
+}
+
+// the slow path alone, with the same rules
+static void checkFallback(const std::string &s) {
+	++checks;
+	const char *p = s.c_str(), *end = p+s.size();
+	float value = 0.f;
+	bool ok = fast_parse_detail::parseFloatFallback(p,end,value);
+	std::string c_s = s; // (strtof with the current locale needs its separator)
+	const char *dp = std::localeconv()->decimal_point;
+	if (c_s.find('.')!=std::string::npos and dp[0]!='.') c_s[c_s.find('.')] = dp[0];
+	char *s_end; float expected = std::strtof(c_s.c_str(),&s_end);
+	if (not ok or std::memcmp(&value,&expected,sizeof(float))!=0 or p-s.c_str()!=s_end-c_s.c_str()) 
+		fail("fallback",s);
+}
+
+static void checkInt(const std::string &s) {
+	++checks;
+	const char *p = s.c_str(), *end = p+s.size();
+	int value = 0;
+	bool ok = parseInt(p,end,value);
+	char *s_end; long expected = std::strtol(s.c_str(),&s_end,10);
+	if (not ok) { if (s_end!=s.c_str()) fail("int not parsed",s); return; }
+	if (value!=expected or p!=s_end) fail("int",s);
+}
+
+// cases that the fast path must send to the fallback
+static const char *fallback_cases[] = {
+	"16777217", "16777219", "33554434.0", "1.00000005960464477539", "0.50000002980232238769531250", // halfway between two floats
+	"0000000000000000000000000001.5", "12345678901234567890123", "0.1234567890123456789012345", // more than 19 digits
+	"1e23", "1e-23", "7.038531e-26", "3.4e38", "1e-30", "123e-40", "9007199254740993", // big exponents/mantissas
+	"1.17549435e-38", "1e-38", "1.4e-45", "1e-45", "7e-46", "1e-50", "-1e-400", // subnormals, underflow
+	"3.4028235e38", "3.40282356e38", "3.4028236e38", "1e39", "-1e40", "1e400" // max and overflow
+};
+
+int main() {
+	std::mt19937_64 rng(42);
+	char buf[128];
+	
+	// random float bit patterns, printed in several formats
+	for(int i=0;i<200000;++i) {
+		std::uint32_t bits = static_cast<std::uint32_t>(rng()); float f; std::memcpy(&f,&bits,4);
+		if (std::isnan(f) or std::isinf(f)) continue;
+		for(const char *fmt : {"%.9g","%g","%.6f","%.12e"}) { std::snprintf(buf,sizeof(buf),fmt,f); checkFloat(buf); }
+		std::snprintf(buf,sizeof(buf),"%.17g",static_cast<double>(f)); checkFloat(buf);
+	}
+	// what .obj files usually have: 6 decimals in [-10;10]
+	for(int i=-10000000;i<=10000000;i+=7) {
+		std::snprintf(buf,sizeof(buf),"%s%d.%06d",i<0?"-":"",std::abs(i)/1000000,std::abs(i)%1000000);
+		checkFloat(buf);
+	}
+	// random digit strings, with up to 30 digits and optional exponents
+	for(int i=0;i<300000;++i) {
+		std::string s; if (rng()%2) s += rng()%2 ? '-' : '+';
+		int digits = 1+rng()%30, dot = rng()%(digits+1);
+		for(int k=0;k<digits;++k) { if (k==dot) s += '.'; s += char('0'+rng()%10); }
+		if (rng()%3==0) { s += rng()%2 ? 'e' : 'E'; s += std::to_string(static_cast<int>(rng()%90)-45); }
+		checkFloat(s);
+	}
+	// halfway cases with every digit, exactly in the middle of two floats
+	for(int i=0;i<20000;++i) {
+		std::uint32_t bits = static_cast<std::uint32_t>(rng())&0x7F7FFFFFu; float f; std::memcpy(&f,&bits,4);
+		double mid = (static_cast<double>(f)+static_cast<double>(std::nextafter(f,INFINITY)))/2;
+		std::snprintf(buf,sizeof(buf),"%.60e",mid); checkFloat(buf);
+		// and close to the middle, with few digits: the nearest double can be
+		// the middle itself, so rounding it again to float may go the wrong way
+		for(int digits=13;digits<=17;++digits) { std::snprintf(buf,sizeof(buf),"%.*e",digits-1,mid); checkFloat(buf); }
+	}
+	for(const char *s : fallback_cases) { checkFloat(s); checkFloat(std::string("-")+s); checkFallback(s); }
+	// edge cases of the grammar
+	for(const char *s : {"0","-0","+0","0.000","-0.0e10",".5","-.5","5.","+3","1e","1e+","1e-","1.5e+x","2.5E3","1e0001","1e99999999999",
+	                     "00012","1.5.5","1..5","1-2","3e4e5"})
+		checkFloat(s);
+	// things that are not decimal numbers: false, and p is not moved
+	for(const char *s : {"","-","+",".","-.","e5",".e5","inf","-inf","nan","NAN","x1"}) {
+		++checks; const char *p = s; float value = 0.f;
+		if (parseFloat(p,s+std::strlen(s),value) or p!=s) fail("invalid",s);
+	}
+	// hexadecimal values are only parsed up to the x
+	{ ++checks; const char *s = "0x1p3", *p = s; float value = 1.f;
+	  if (not parseFloat(p,s+5,value) or value!=0.f or p!=s+1) fail("hex",s); }
+	// the range does not need to be null terminated
+	{ ++checks; const char *s = "12.3456e7", *p = s; float value = 0.f;
+	  if (not parseFloat(p,s+4,value) or value!=12.3f or p!=s+4) fail("range",s); }
+	{ ++checks; const char *s = "1234567890123", *p = s; float value = 0.f; // (the 8 digits block reads past end)
+	  if (not parseFloat(p,s+10,value) or value!=1234567890.f or p!=s+10) fail("range",s); }
+	// ints
+	for(const char *s : {"0","-0","+7","42","-17","123456789","2147483647","-2147483648","12a","-","x",""}) checkInt(s);
+	for(int i=0;i<100000;++i) checkInt(std::to_string(static_cast<int>(rng())));
+	
+	// the result must not depend on the locale (the fallback uses strtof)
+	if (std::setlocale(LC_NUMERIC,"de_DE.UTF-8") or std::setlocale(LC_NUMERIC,"es_AR.UTF-8") or std::setlocale(LC_NUMERIC,"fr_FR.UTF-8")) {
+		for(const char *s : fallback_cases) checkFallback(s);
+		std::setlocale(LC_NUMERIC,"C");
+		std::printf("fallback checked with a ',' locale too\n");
+	}
+	for(const char *s : {"1.5","16777217","1e-45"}) {
+		++checks; const char *p = s; float value = 0.f;
+		if (not parseFloat(p,s+std::strlen(s),value) or value!=std::strtof(s,nullptr)) fail("after locale",s);
+	}
+	
+	// speed, on 1M numbers like the ones of a "v x y z" line
+	{
+		std::string text; char buf[32];
+		std::uniform_real_distribution<float> coord(-100.f,100.f);
+		const int count = 1000000;
+		for(int i=0;i<count;++i) { std::snprintf(buf,sizeof(buf),"%.6f ",coord(rng)); text += buf; }
+		const char *begin = text.c_str(), *end = begin+text.size();
+		double sum_strtof = 0.0, sum_parse = 0.0;
+		double t_strtof = bestTime([&]() {
+			sum_strtof = 0.0;
+			for(const char *p=begin; p<end; ++p) { char *e; sum_strtof += std::strtof(p,&e); p = e; }
+		});
+		double t_parse = bestTime([&]() {
+			sum_parse = 0.0;
+			for(const char *p=begin; p<end; ++p) { float value = 0.f; parseFloat(p,end,value); sum_parse += value; }
+		});
+		std::printf("strtof     %6.1f Mfloats/s\nparseFloat %6.1f Mfloats/s\n",count/t_strtof*1e-6,count/t_parse*1e-6);
+		++checks;
+		if (sum_parse!=sum_strtof) { ++failures; std::printf("FAIL: different values in the speed test\n"); }
+		if (t_parse>t_strtof) { ++failures; std::printf("FAIL: parseFloat slower than strtof\n"); }
+	}
+	
+	std::printf("%ld checks, %ld failures\n",checks,failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+// Times Geometry::generateNormals (in parallel, with the shared ThreadPool)
+// against a serial loop (the original version) on a mesh with 4M triangles,
+// and updateNormals after moving a few vertexes, and checks that all of
+// them give exactly the same normals. Build and run from this folder with:
+//   g++ -std=c++14 -O2 -I../utils -I../third/glad NormalsBench.cpp ../utils/Geometry.cpp ../utils/VertexAdjacency.cpp ../utils/VertexQuantization.cpp ../utils/ThreadPool.cpp ../utils/Misc.cpp ../third/glad/glad.c -lpthread -ldl -o NormalsBench && ./NormalsBench
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Geometry.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+// n x n wavy grid, 2*(n-1)^2 triangles
+Geometry makeGrid(int n) {
+	Geometry g;
+	for(int i=0;i<n;++i)
+		for(int j=0;j<n;++j) {
+			float x = i/float(n-1), y = j/float(n-1);
+			g.positions.push_back(glm::vec3(x,y,0.1f*std::sin(20.f*x)*std::cos(20.f*y)));
+		}
+	for(int i=0;i+1<n;++i)
+		for(int j=0;j+1<n;++j) {
+			int a = i*n+j, b = a+n, c = b+1, d = a+1;
+			g.triangles.insert(g.triangles.end(),{a,b,c,a,c,d});
+		}
+	return g;
+}
+
+// the serial scatter loop generateNormals had before
+std::vector<glm::vec3> serialNormals(const Geometry &g) {
+	std::vector<glm::vec3> normals(g.positions.size(),glm::vec3(0.f));
+	for(std::size_t i=0;i<g.triangles.size();i+=3) {
+		const int *t = &g.triangles[i];
+		glm::vec3 n = glm::cross(g.positions[t[2]]-g.positions[t[1]],g.positions[t[0]]-g.positions[t[1]]);
+		normals[t[0]] += n; normals[t[1]] += n; normals[t[2]] += n;
+	}
+	for(glm::vec3 &n : normals)
+		if (glm::dot(n,n)!=0) n = glm::normalize(n);
+	return normals;
+}
+
+bool sameNormals(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b) {
+	return a.size()==b.size() and std::memcmp(a.data(),b.data(),a.size()*sizeof(glm::vec3))==0;
+}
+
+double bestTime(const std::function<void()> &f, int runs = 3) {
+	double best = 1e30;
+	for(int r=0;r<runs;++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count());
+	}
+	return best;
+}
+
+}
+
+int main() {
+	Geometry g = makeGrid(1449);
+	std::printf("%zu triangles, %zu vertexes, %d threads\n",g.triangles.size()/3,g.positions.size(),ThreadPool::shared().size());
+	int failures = 0;
+
+	std::vector<glm::vec3> expected;
+	double t_serial = bestTime([&](){ expected = serialNormals(g); });
+	double t_parallel = bestTime([&](){ g.generateNormals(); });
+	std::printf("%-28s %8.1f ms\n%-28s %8.1f ms%s\n","serial (original)",t_serial,"generateNormals",t_parallel,
+				sameNormals(g.normals,expected) ? "" : "   FAIL: different normals");
+	if (not sameNormals(g.normals,expected)) ++failures;
+	if (t_parallel>1.5*t_serial+1.0) { std::printf("   FAIL: slower than the serial loop\n"); ++failures; }
+
+	// the first updateNormals also builds the adjacency
+	std::mt19937 rng(1);
+	auto t0 = std::chrono::steady_clock::now();
+	g.adjacency();
+	std::printf("%-28s %8.1f ms\n","adjacency (first update)",std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count());
+	for(int moved_count : {100,10000}) {
+		std::vector<int> moved(moved_count);
+		for(int &v : moved) {
+			v = static_cast<int>(rng()%g.positions.size());
+			g.positions[v].z += 0.01f;
+		}
+		double t_update = bestTime([&](){ g.updateNormals(moved); });
+		bool same = sameNormals(g.normals,serialNormals(g));
+		std::printf("updateNormals, %5d moved   %8.1f ms%s\n",moved_count,t_update,same ? "" : "   FAIL: different normals");
+		if (not same) ++failures;
+	}
+	std::printf("%d failures\n",failures);
+	return failures ? 1 : 0;
+}
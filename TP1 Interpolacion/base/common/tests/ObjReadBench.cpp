@@ -0,0 +1,99 @@
+// Measures readObj (ObjMesh.hpp) throughput, in MB/s, with each ObjReadMode
+// (Stream, Mapped, Parallel), on chookity.obj and on a synthetic .obj with
+// 10M triangles (about 1 GB, written next to the program and deleted at the
+// end; pass another amount of faces as the first argument). It also checks
+// that the three modes give the same ObjMesh (readObj logs each read to
+// stderr). Build and run from this folder with:
+//   g++ -std=c++14 -O2 -I../utils -I../third/glad ObjReadBench.cpp ../utils/ObjMesh.cpp ../utils/FastParse.cpp ../utils/MappedFile.cpp ../utils/Misc.cpp ../utils/ThreadPool.cpp ../utils/Geometry.cpp ../utils/VertexAdjacency.cpp ../utils/VertexQuantization.cpp ../third/glad/glad.c -lpthread -ldl -o ObjReadBench && ./ObjReadBench
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ObjMesh.hpp"
+
+namespace {
+
+// a grid of n x n vertexes (with normals and texture coordinates), in
+// triangles, split in parts of some rows each, with at least the given
+// amount of faces
+void writeGrid(const std::string &path, long faces) {
+	int n = static_cast<int>(std::ceil(std::sqrt(faces/2.0)))+1;
+	std::FILE *f = std::fopen(path.c_str(),"w");
+	for(int i=0;i<n;++i)
+		for(int j=0;j<n;++j) {
+			float x = i/float(n-1), y = j/float(n-1), z = 0.1f*std::sin(20.f*x)*std::cos(20.f*y);
+			std::fprintf(f,"v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",x,y,z,x,y,-z,0.f,1.f);
+		}
+	for(int i=0;i+1<n;++i) {
+		if (i%64==0) std::fprintf(f,"o rows_%d\n",i);
+		for(int j=0;j+1<n;++j) {
+			int a = i*n+j+1, b = a+n, c = b+1, d = a+1; // (1-based)
+			std::fprintf(f,"f %d/%d/%d %d/%d/%d %d/%d/%d\n",a,a,a,b,b,b,c,c,c);
+			std::fprintf(f,"f %d/%d/%d %d/%d/%d %d/%d/%d\n",a,a,a,c,c,c,d,d,d);
+		}
+	}
+	std::fclose(f);
+}
+
+template<typename T>
+bool sameBytes(const std::vector<T> &a, const std::vector<T> &b) {
+	return a.size()==b.size() and (a.empty() or std::memcmp(a.data(),b.data(),a.size()*sizeof(T))==0);
+}
+
+bool sameMesh(const ObjMesh &a, const ObjMesh &b) {
+	if (not sameBytes(a.positions,b.positions) or not sameBytes(a.normals,b.normals)
+		or not sameBytes(a.tex_coords,b.tex_coords) or a.parts.size()!=b.parts.size()) return false;
+	for(std::size_t i=0;i<a.parts.size();++i)
+		if (a.parts[i].name!=b.parts[i].name or not sameBytes(a.parts[i].elements,b.parts[i].elements)) return false;
+	return true;
+}
+
+long fileSize(const std::string &path) {
+	std::FILE *f = std::fopen(path.c_str(),"rb");
+	if (not f) return -1;
+	std::fseek(f,0,SEEK_END);
+	long size = std::ftell(f);
+	std::fclose(f);
+	return size;
+}
+
+// best of some runs of each mode; false if the modes don't agree
+bool bench(const std::string &name, const std::string &path, int runs) {
+	const struct { const char *name; ObjReadMode mode; } modes[] =
+		{ {"Stream",ObjReadMode::Stream}, {"Mapped",ObjReadMode::Mapped}, {"Parallel",ObjReadMode::Parallel} };
+	double mb = fileSize(path)/1048576.0;
+	std::printf("%s (%.1f MB)\n",name.c_str(),mb);
+	ObjMesh first; bool same = true;
+	for(const auto &m : modes) {
+		double best = 1e30;
+		for(int r=0;r<runs;++r) {
+			auto t0 = std::chrono::steady_clock::now();
+			ObjMesh obj = readObj(path,m.mode);
+			best = std::min(best,std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count());
+			if (r==0 and m.mode==ObjReadMode::Stream) first = std::move(obj);
+			else if (r==0) same = same and sameMesh(obj,first);
+		}
+		std::printf("  %-9s %9.1f ms %8.1f MB/s\n",m.name,best*1000.0,mb/best);
+	}
+	if (not same) std::printf("  FAIL: the modes read different meshes\n");
+	return same;
+}
+
+}
+
+int main(int argc, char **argv) {
+	long faces = argc>1 ? std::atol(argv[1]) : 10000000L;
+	int failures = 0;
+	if (not bench("chookity.obj","../../bin/models/chookity.obj",10)) ++failures;
+	std::string path = "ObjReadBench_grid.obj";
+	std::printf("writing %ld faces...\n",faces);
+	writeGrid(path,faces);
+	if (not bench("grid, "+std::to_string(faces)+" faces",path,1)) ++failures;
+	std::remove(path.c_str());
+	std::printf("%d failures\n",failures);
+	return failures ? 1 : 0;
+}
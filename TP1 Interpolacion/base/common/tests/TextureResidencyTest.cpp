@@ -0,0 +1,166 @@
+// Checks TextureResidency (Texture.hpp) without a window: a fake OpenGL keeps
+// the bytes of every level of every texture and its GL_TEXTURE_BASE_LEVEL, so
+// the test can verify that the resident levels stay under the budget, that
+// they are evicted in the documented order (levels not needed first, then the
+// textures requested less recently, the biggest level first), and that
+// memorySize() matches what is really allocated. Build and run from this folder with:
+//   g++ -std=c++14 -O2 -I../utils -I../third/glad -I../third/stb TextureResidencyTest.cpp ../utils/Texture.cpp ../utils/TextureCache.cpp ../utils/Misc.cpp ../utils/MappedFile.cpp ../utils/ThreadPool.cpp ../third/stb/stb_image.c ../third/glad/glad.c -lpthread -ldl -o TextureResidencyTest && ./TextureResidencyTest
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "Texture.hpp"
+
+namespace {
+
+// fake OpenGL (only what Texture uses for streamed textures)
+GLuint bound = 0;
+std::map<GLuint,std::map<int,std::size_t>> gpu_levels; // texture -> level -> bytes
+std::map<GLuint,int> base_levels;
+
+void APIENTRY fakeGenTextures(GLsizei n, GLuint *ids) { static GLuint next = 1; for(int i=0;i<n;++i) ids[i] = next++; }
+void APIENTRY fakeDeleteTextures(GLsizei n, const GLuint *ids) { for(int i=0;i<n;++i) { gpu_levels.erase(ids[i]); base_levels.erase(ids[i]); } }
+void APIENTRY fakeBindTexture(GLenum, GLuint id) { bound = id; }
+void APIENTRY fakeTexParameteri(GLenum, GLenum pname, GLint value) { if (pname==GL_TEXTURE_BASE_LEVEL) base_levels[bound] = value; }
+void APIENTRY fakePixelStorei(GLenum, GLint) { }
+void APIENTRY fakeGenerateMipmap(GLenum) { }
+void APIENTRY fakeTexImage2D(GLenum, GLint level, GLint, GLsizei w, GLsizei h, GLint, GLenum, GLenum, const void*) {
+	gpu_levels[bound][level] = std::size_t(w)*h*4; // (always GL_RGBA)
+}
+void APIENTRY fakeCompressedTexImage2D(GLenum, GLint level, GLenum, GLsizei, GLsizei, GLint, GLsizei size, const void*) {
+	gpu_levels[bound][level] = size;
+}
+
+void installFakeGL() {
+	glad_glGenTextures = fakeGenTextures; glad_glDeleteTextures = fakeDeleteTextures;
+	glad_glBindTexture = fakeBindTexture; glad_glTexParameteri = fakeTexParameteri;
+	glad_glPixelStorei = fakePixelStorei; glad_glGenerateMipmap = fakeGenerateMipmap;
+	glad_glTexImage2D = fakeTexImage2D; glad_glCompressedTexImage2D = fakeCompressedTexImage2D;
+}
+
+std::size_t gpuBytes(GLuint id) {
+	std::size_t bytes = 0;
+	for(const auto &l : gpu_levels[id]) bytes += l.second;
+	return bytes;
+}
+
+// the images are 1024x1024 RGBA, and the smallest levels (up to 64x64,
+// level 4) are always resident
+const int size = 1024, tail = 4;
+std::size_t levelBytes(int level) { return std::size_t(size>>level)*(size>>level)*4; }
+std::size_t bytesFrom(int level) {
+	std::size_t bytes = 0;
+	for(int l=level; (size>>l)>0; ++l) bytes += levelBytes(l);
+	return bytes;
+}
+
+int failures = 0;
+void check(bool ok, const std::string &what) {
+	if (ok) return;
+	std::printf("FAIL: %s\n",what.c_str());
+	++failures;
+}
+
+struct Request { const Texture *texture; float screen_size; };
+
+// one frame: the requests, then update(); checks what every update must keep
+void frame(const std::vector<const Texture*> &textures, const std::vector<Request> &requests,
+		   std::size_t upload_budget = 4<<20)
+{
+	TextureResidency &residency = TextureResidency::shared();
+	for(const Request &r : requests) residency.request(*r.texture,r.screen_size);
+	residency.update(upload_budget);
+	std::size_t resident = 0; bool only_tails = true;
+	for(const Texture *t : textures) {
+		GLuint id = t->getId();
+		int base = base_levels[id];
+		resident += gpuBytes(id);
+		only_tails = only_tails and base==tail;
+		check(t->memorySize()==gpuBytes(id),"memorySize of texture "+std::to_string(id)+" is not the memory allocated");
+		for(const auto &l : gpu_levels[id])
+			check((l.first<base)==(l.second==0),"texture "+std::to_string(id)+" has levels allocated above its base or missing below it");
+	}
+	check(residency.stats().resident_bytes==resident,"stats().resident_bytes is not the memory allocated");
+	check(resident<=residency.getBudget() or only_tails,"over the budget with levels that could be dropped");
+}
+
+// updates until nothing else is uploaded
+void settle(const std::vector<const Texture*> &textures, const std::vector<Request> &requests) {
+	do frame(textures,requests); while (TextureResidency::shared().stats().loaded_levels>0);
+}
+
+}
+
+int main() {
+	installFakeGL();
+	TextureResidency &residency = TextureResidency::shared();
+	const std::string chookity = "../../bin/models/chookity.png", suzanne = "../../bin/models/suzanne.png";
+	int flags = Texture::fStreamed|Texture::fNoCache; // (no cache files next to the models)
+	Texture a(chookity,true,true,flags), b(suzanne,true,true,flags), c(chookity,true,true,flags);
+	std::vector<const Texture*> all = {&a,&b,&c};
+	auto base = [](const Texture &t) { return base_levels[t.getId()]; };
+
+	// only the tail is uploaded when a texture is created
+	for(const Texture *t : all)
+		check(base(*t)==tail and t->memorySize()==bytesFrom(tail) and gpuBytes(t->getId())==bytesFrom(tail),"only the tail is resident after creating the texture");
+
+	// with an upload budget of 1 byte, one level per update
+	int updates = 0;
+	do {
+		frame(all,{{&a,1024.f},{&b,1024.f},{&c,1024.f}},1);
+		check(residency.stats().loaded_levels<=1,"more than one level uploaded over the upload budget");
+		++updates;
+	} while (residency.stats().loaded_levels>0);
+	check(updates==3*tail+1,"every level should take one update");
+	for(const Texture *t : all) check(base(*t)==0 and t->memorySize()==bytesFrom(0),"every level resident when requested at full size");
+	check(residency.stats().needed_bytes==3*bytesFrom(0),"needed_bytes with every level requested");
+
+	// levels that are not needed anymore are dropped first: c only needs
+	// level 2 now, so its level 0 goes before any level of a or b
+	residency.setBudget(3*bytesFrom(0)-1);
+	frame(all,{{&a,1024.f},{&b,1024.f},{&c,256.f}});
+	check(base(a)==0 and base(b)==0 and base(c)==1,"c's level 0 (not needed) should be the first one dropped");
+
+	// then the textures requested less recently: neither b nor c are needed,
+	// but c was requested before b, so all of c goes before b's level 0
+	frame(all,{{&a,1024.f},{&b,1024.f}});
+	check(base(a)==0 and base(b)==0 and base(c)==1,"nothing should change while it fits in the budget");
+	residency.setBudget(residency.stats().resident_bytes-(bytesFrom(1)-bytesFrom(tail))-1);
+	frame(all,{{&a,1024.f}});
+	check(base(a)==0 and base(b)==1 and base(c)==tail,"c (requested less recently) should be dropped to its tail before b");
+
+	// and with the same last request, the biggest level first: a's level 0
+	// goes before b's level 1
+	residency.setBudget(residency.stats().resident_bytes-1);
+	frame(all,{{&a,1.f},{&b,1.f}});
+	check(base(a)==1 and base(b)==1 and base(c)==tail,"a's level 0 (the biggest) should be dropped before b's level 1");
+
+	// needed levels also go if they don't fit, but the tails always stay
+	residency.setBudget(0);
+	frame(all,{{&a,1024.f},{&b,1024.f},{&c,1024.f}});
+	for(const Texture *t : all) check(base(*t)==tail,"only the tails should be resident with a budget of 0");
+	check(residency.stats().resident_bytes==3*bytesFrom(tail),"the tails are always resident");
+
+	// a budget for one full texture: a gets every level, the others keep their tails
+	residency.setBudget(bytesFrom(0)+2*bytesFrom(tail));
+	settle(all,{{&a,1024.f}});
+	check(base(a)==0 and base(b)==tail and base(c)==tail,"a should be fully resident, b and c only their tails");
+
+	// a deleted texture leaves the residency set and frees its memory
+	{ Texture moved(std::move(c)); }
+	all.pop_back();
+	frame(all,{{&a,1024.f}});
+	check(residency.stats().textures==2,"a deleted texture should not be tracked");
+	check(residency.stats().resident_bytes==bytesFrom(0)+bytesFrom(tail),"resident bytes after deleting a texture");
+
+	// a texture that is not requested anymore does not keep its old size: with
+	// a dropped to its tail, b (requested now, but smaller) gets the first level
+	residency.setBudget(0);
+	frame(all,{{&a,1024.f}});
+	residency.setBudget(2*bytesFrom(0));
+	frame(all,{{&b,512.f}},1);
+	check(base(a)==tail and base(b)==tail-1,"b (on screen) should get the first level before a (not requested)");
+	
+	std::printf("%d failures\n",failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// Checks that toGeometry (ObjMesh.hpp) gives exactly the same vertexes and
+// triangles than a plain std::unordered_map dedup (the original version),
+// and that it is not slower, also for meshes with many (normal,texcoord)
+// variants per position. Build and run from this folder with:
+//   g++ -std=c++14 -O2 -I../utils -I../third/glad VertexDedupTest.cpp ../utils/ObjMesh.cpp ../utils/FastParse.cpp ../utils/MappedFile.cpp ../utils/Misc.cpp ../utils/ThreadPool.cpp ../utils/Geometry.cpp ../utils/VertexAdjacency.cpp ../utils/VertexQuantization.cpp ../third/glad/glad.c -lpthread -ldl -o VertexDedupTest && ./VertexDedupTest
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include "ObjMesh.hpp"
+
+namespace {
+
+struct TupleHash {
+	std::size_t operator()(const std::tuple<int,int,int> &t) const {
+		std::hash<int> h;
+		return ((h(std::get<0>(t))^(h(std::get<1>(t))<<1))>>1)^(h(std::get<2>(t))<<1);
+	}
+};
+
+Geometry referenceGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+	Geometry g;
+	std::unordered_map<std::tuple<int,int,int>,int,TupleHash> map;
+	auto addVertex = [&g,&obj,&map](const ObjMesh::Element &e, int inode) {
+		auto p = map.insert({std::make_tuple(e.pos[inode],e.norms[inode],e.tcs[inode]),static_cast<int>(g.positions.size())});
+		if (p.second) {
+			g.positions.push_back(obj.positions[e.pos[inode]]);
+			if (e.norms[inode]!=-1) g.normals.push_back(obj.normals[e.norms[inode]]);
+			if (e.tcs[inode]!=-1) g.tex_coords.push_back(obj.tex_coords[e.tcs[inode]]);
+		}
+		g.triangles.push_back(p.first->second);
+	};
+	for(const ObjMesh::Element &e : part.elements) {
+		addVertex(e,0); addVertex(e,1); addVertex(e,2);
+		if (e.pos[3]==-1) continue;
+		addVertex(e,0); addVertex(e,2); addVertex(e,3);
+	}
+	return g;
+}
+
+template<typename V>
+bool sameVectors(const std::vector<V> &a, const std::vector<V> &b) {
+	if (a.size()!=b.size()) return false;
+	for(std::size_t i=0;i<a.size();++i)
+		for(int k=0;k<V::length();++k) 
+			if (a[i][k]!=b[i][k]) return false;
+	return true;
+}
+
+enum class Attribs { Smooth, FlatNormals, CornerTexCoords, PositionsOnly };
+
+// n x n grid of positions, as triangles or quads; the normals and texture
+// coordinates are shared by the faces (Smooth), or there is one normal per
+// face (FlatNormals, like an .obj exported with flat shading), or one
+// texture coordinate per face corner (CornerTexCoords, like lots of seams)
+ObjMesh makeGrid(int n, Attribs attribs, bool quads, bool shuffle) {
+	ObjMesh obj;
+	for(int i=0;i<n;++i) 
+		for(int j=0;j<n;++j) 
+			obj.positions.push_back(glm::vec3(float(i),float(j),float((i*j)%7)));
+	obj.parts.resize(1);
+	auto index = [n](int i, int j) { return i*n+j; };
+	auto addFace = [&](std::vector<int> v) {
+		ObjMesh::Element e;
+		for(int k=0;k<4;++k) { e.pos[k] = e.norms[k] = e.tcs[k] = -1; }
+		for(std::size_t k=0;k<v.size();++k) {
+			e.pos[k] = v[k];
+			switch (attribs) {
+			case Attribs::Smooth: e.norms[k] = e.tcs[k] = v[k]; break;
+			case Attribs::FlatNormals: e.norms[k] = static_cast<int>(obj.parts[0].elements.size()); e.tcs[k] = v[k]; break;
+			case Attribs::CornerTexCoords: e.norms[k] = v[k]; e.tcs[k] = static_cast<int>(obj.tex_coords.size()); 
+				obj.tex_coords.push_back(glm::vec2(float(obj.tex_coords.size()),0.f)); break;
+			case Attribs::PositionsOnly: break;
+			}
+		}
+		if (attribs==Attribs::FlatNormals) obj.normals.push_back(glm::vec3(0.f,0.f,float(obj.normals.size())));
+		obj.parts[0].elements.push_back(e);
+	};
+	for(int i=0;i+1<n;++i) {
+		for(int j=0;j+1<n;++j) {
+			if (quads) addFace({index(i,j),index(i+1,j),index(i+1,j+1),index(i,j+1)});
+			else { addFace({index(i,j),index(i+1,j),index(i+1,j+1)}); addFace({index(i,j),index(i+1,j+1),index(i,j+1)}); }
+		}
+	}
+	if (attribs==Attribs::Smooth or attribs==Attribs::CornerTexCoords)
+		for(int i=0;i<n*n;++i) obj.normals.push_back(glm::vec3(0.f,float(i),1.f));
+	if (attribs==Attribs::Smooth or attribs==Attribs::FlatNormals)
+		for(int i=0;i<n*n;++i) obj.tex_coords.push_back(glm::vec2(float(i),1.f));
+	if (shuffle) std::shuffle(obj.parts[0].elements.begin(),obj.parts[0].elements.end(),std::mt19937(1));
+	return obj;
+}
+
+// so many normals and texture coordinates that the key does not fit in 64 bits
+ObjMesh makeWide() {
+	ObjMesh obj = makeGrid(200,Attribs::FlatNormals,false,false);
+	int big = 1<<22;
+	obj.normals.resize(big); obj.tex_coords.resize(big);
+	std::mt19937 rng(2);
+	for(ObjMesh::Element &e : obj.parts[0].elements)
+		for(int k=0;k<3;++k) {
+			if (rng()%2) { e.norms[k] = big-1-static_cast<int>(rng()%1000); obj.normals[e.norms[k]] = glm::vec3(float(e.norms[k])); }
+			if (rng()%2) { e.tcs[k] = big-1-static_cast<int>(rng()%1000); obj.tex_coords[e.tcs[k]] = glm::vec2(float(e.tcs[k])); }
+		}
+	return obj;
+}
+
+double bestTime(const std::function<void()> &f) {
+	double best = 1e30;
+	for(int r=0;r<3;++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count());
+	}
+	return best;
+}
+
+}
+
+int main() {
+	struct Case { const char *name; ObjMesh obj; };
+	std::vector<Case> cases;
+	cases.push_back({"smooth",makeGrid(300,Attribs::Smooth,false,false)});
+	cases.push_back({"smooth quads",makeGrid(300,Attribs::Smooth,true,false)});
+	cases.push_back({"flat normals",makeGrid(300,Attribs::FlatNormals,false,false)});
+	cases.push_back({"flat normals, shuffled",makeGrid(300,Attribs::FlatNormals,false,true)});
+	cases.push_back({"tex coords per corner",makeGrid(300,Attribs::CornerTexCoords,false,false)});
+	cases.push_back({"tex coords per corner, quads",makeGrid(300,Attribs::CornerTexCoords,true,false)});
+	cases.push_back({"positions only",makeGrid(300,Attribs::PositionsOnly,false,false)});
+	cases.push_back({"key wider than 64 bits",makeWide()});
+	
+	int failures = 0;
+	std::printf("%-30s %9s %9s %11s %11s\n","mesh","faces","vertexes","unordered","toGeometry");
+	for(const Case &c : cases) {
+		const ObjMesh::Part &part = c.obj.parts[0];
+		Geometry expected = referenceGeometry(c.obj,part), g = toGeometry(c.obj,part);
+		bool same = sameVectors(g.positions,expected.positions) and sameVectors(g.normals,expected.normals)
+			and sameVectors(g.tex_coords,expected.tex_coords) and g.triangles==expected.triangles;
+		double t_ref = bestTime([&](){ referenceGeometry(c.obj,part); });
+		double t_new = bestTime([&](){ toGeometry(c.obj,part); });
+		std::printf("%-30s %9zu %9zu %8.1f ms %8.1f ms%s\n",c.name,part.elements.size(),g.positions.size(),t_ref,t_new,
+					same ? "" : "   FAIL: different output");
+		if (not same) ++failures;
+		if (t_new>1.5*t_ref+1.0) { std::printf("   FAIL: slower than the reference\n"); ++failures; }
+	}
+	std::printf("%d failures\n",failures);
+	return failures ? 1 : 0;
+}
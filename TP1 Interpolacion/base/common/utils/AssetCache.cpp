@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <vector>
+#include "AssetCache.hpp"
+
+AssetCache &AssetCache::shared() {
+	static AssetCache cache;
+	return cache;
+}
+
+std::shared_ptr<Texture> AssetCache::texture(const std::string &fname, int flags) {
+	trim();
+	Entry &e = entries["texture:"+fname+"|"+std::to_string(flags)];
+	e.last_use = tick;
+	if (e.texture) { ++hits; return e.texture; }
+	++misses;
+	e.texture = std::make_shared<Texture>(fname,true,true,flags);
+	return e.texture;
+}
+
+std::shared_ptr<GeometryRenderer> AssetCache::geometry(const std::string &key, const std::function<GeometryRenderer()> &create) {
+	trim();
+	Entry &e = entries["geometry:"+key];
+	e.last_use = tick;
+	if (e.geometry) { ++hits; return e.geometry; }
+	++misses;
+	e.geometry = std::make_shared<GeometryRenderer>(create());
+	return e.geometry;
+}
+
+std::shared_ptr<TextureArray> AssetCache::textureArray(const std::string &key, const std::function<TextureArray()> &create) {
+	trim();
+	Entry &e = entries["array:"+key];
+	e.last_use = tick;
+	if (e.texture_array) { ++hits; return e.texture_array; }
+	++misses;
+	e.texture_array = std::make_shared<TextureArray>(create());
+	return e.texture_array;
+}
+
+void AssetCache::setBudget(std::size_t bytes) {
+	budget = bytes;
+	trim();
+}
+
+void AssetCache::trim() {
+	// assets still in use are marked as used now, so the unused ones are
+	// sorted by (roughly) when they were released
+	++tick;
+	std::vector<std::pair<std::uint64_t,std::string>> unused;
+	std::size_t unused_bytes = 0;
+	for(auto &p : entries) {
+		Entry &e = p.second;
+		if (e.isEmpty()) continue;
+		if (e.inUse()) { e.last_use = tick; continue; }
+		unused.emplace_back(e.last_use,p.first);
+		unused_bytes += e.memorySize();
+	}
+	if (unused_bytes<=budget) return;
+	std::sort(unused.begin(),unused.end());
+	for(auto &u : unused) {
+		if (unused_bytes<=budget) break;
+		auto it = entries.find(u.second);
+		unused_bytes -= std::min(unused_bytes,it->second.memorySize());
+		entries.erase(it);
+	}
+}
+
+void AssetCache::clear() {
+	for(auto it=entries.begin(); it!=entries.end(); ) {
+		if (it->second.inUse()) ++it;
+		else it = entries.erase(it);
+	}
+}
+
+AssetCache::Stats AssetCache::stats() const {
+	Stats st; st.hits = hits; st.misses = misses;
+	for(const auto &p : entries) {
+		const Entry &e = p.second;
+		if (e.isEmpty()) continue;
+		if (e.geometry) ++st.geometries; else ++st.textures;
+		(e.inUse() ? st.used_bytes : st.unused_bytes) += e.memorySize();
+	}
+	return st;
+}
+
@@ -0,0 +1,62 @@
+#ifndef ASSET_CACHE_HPP
+#define ASSET_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Texture.hpp"
+#include "Geometry.hpp"
+
+// Shares the GPU copies of textures and vertex buffers: asking again for the
+// same key (image and flags, or model, part and format) returns the same
+// object instead of uploading another copy (arrays are keyed by whoever
+// packs them, see Model::packTextures). Assets that nobody else uses
+// anymore are kept, so loading the same model again uploads nothing, until
+// they take more than the budget; then the least recently used ones are
+// deleted. It must be used only from the thread that owns the OpenGL context.
+class AssetCache {
+public:
+	static AssetCache &shared();
+
+	std::shared_ptr<Texture> texture(const std::string &fname, int flags=0); // (Texture's flags)
+	// create is called only if the key is not in the cache
+	std::shared_ptr<GeometryRenderer> geometry(const std::string &key, const std::function<GeometryRenderer()> &create);
+	std::shared_ptr<TextureArray> textureArray(const std::string &key, const std::function<TextureArray()> &create);
+
+	void setBudget(std::size_t bytes); // for unused assets (default 256 MB)
+	void trim(); // deletes unused assets until they fit in the budget
+	void clear(); // deletes every unused asset
+
+	struct Stats {
+		int textures = 0, geometries = 0; // in the cache (used or not; arrays count as textures)
+		int hits = 0, misses = 0;
+		std::size_t used_bytes = 0, unused_bytes = 0; // GPU memory
+	};
+	Stats stats() const;
+
+private:
+	AssetCache() = default;
+	AssetCache(const AssetCache &) = delete;
+	AssetCache &operator=(const AssetCache &) = delete;
+	struct Entry {
+		std::shared_ptr<Texture> texture; // only one of these three
+		std::shared_ptr<GeometryRenderer> geometry;
+		std::shared_ptr<TextureArray> texture_array;
+		std::uint64_t last_use = 0; // last time it was asked for, or seen in use
+		bool isEmpty() const { return not texture and not geometry and not texture_array; } // (being created)
+		bool inUse() const { return texture.use_count()>1 or geometry.use_count()>1 or texture_array.use_count()>1; }
+		std::size_t memorySize() const { 
+			return texture ? texture->memorySize() : geometry ? geometry->memorySize() 
+				 : texture_array ? texture_array->memorySize() : 0;
+		}
+	};
+	std::unordered_map<std::string,Entry> entries;
+	std::size_t budget = 256<<20;
+	std::uint64_t tick = 0;
+	int hits = 0, misses = 0;
+};
+
+#endif
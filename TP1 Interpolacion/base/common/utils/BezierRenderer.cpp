@@ -1,7 +1,8 @@
 #include "BezierRenderer.hpp"
 #include "Debug.hpp"
 
-BezierRenderer::BezierRenderer(int nsamples) : shader("shaders/curve") { 
+BezierRenderer::BezierRenderer(int nsamples) { 
+	shader.loadDeferred("shaders/curve");
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 	
@@ -0,0 +1,84 @@
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &fname) {
+	HANDLE file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+							  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file==INVALID_HANDLE_VALUE) return;
+	file_handle = file;
+	LARGE_INTEGER fsize;
+	if (not GetFileSizeEx(file,&fsize)) { freeResources(); return; }
+	data_size = static_cast<std::size_t>(fsize.QuadPart);
+	if (data_size==0) { ok = true; return; } // empty files can not be mapped
+	map_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (not map_handle) { freeResources(); return; }
+	data_ptr = static_cast<const char*>(MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0));
+	if (not data_ptr) { freeResources(); return; }
+	ok = true;
+}
+
+void MappedFile::freeResources() {
+	if (data_ptr) UnmapViewOfFile(data_ptr);
+	if (map_handle) CloseHandle(map_handle);
+	if (file_handle) CloseHandle(file_handle);
+	data_ptr = nullptr; map_handle = file_handle = nullptr;
+	data_size = 0; ok = false;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &fname) {
+	int fd = ::open(fname.c_str(), O_RDONLY);
+	if (fd==-1) return;
+	struct stat st;
+	if (::fstat(fd,&st)==0) {
+		data_size = static_cast<std::size_t>(st.st_size);
+		if (data_size==0) { // empty files can not be mapped
+			ok = true;
+		} else {
+			void *p = ::mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p!=MAP_FAILED) {
+				::madvise(p, data_size, MADV_SEQUENTIAL);
+				data_ptr = static_cast<const char*>(p);
+				ok = true;
+			} else 
+				data_size = 0;
+		}
+	}
+	::close(fd); // the mapping keeps its own reference to the file
+}
+
+void MappedFile::freeResources() {
+	if (data_ptr) ::munmap(const_cast<char*>(data_ptr), data_size);
+	data_ptr = nullptr; data_size = 0; ok = false;
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile &&f) {
+	*this = static_cast<const MappedFile&>(f);
+	f = static_cast<const MappedFile&>(MappedFile());
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&f) {
+	freeResources();
+	*this = static_cast<const MappedFile&>(f);
+	f = static_cast<const MappedFile&>(MappedFile());
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	freeResources();
+}
+
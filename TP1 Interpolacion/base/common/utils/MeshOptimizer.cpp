@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "MeshOptimizer.hpp"
+#include "Debug.hpp"
+
+namespace {
+
+const int cache_size = 32; // simulated LRU cache used for the scores
+
+// score of a vertex, given its position in the cache (-1 if not there) 
+// and how many triangles not yet emitted still use it
+float vertexScore(int cache_pos, int remaining) {
+	if (remaining==0) return -1.f; // no more triangles, will never be used
+	float score = 0.f;
+	if (cache_pos>=0) {
+		if (cache_pos<3) { // used by the last triangle, avoid it a bit
+			score = 0.75f; // (so strips do not go back and forth)
+		} else {
+			float s = 1.f-float(cache_pos-3)/(cache_size-3);
+			score = std::pow(s,1.5f);
+		}
+	}
+	// bonus for vertexes with few triangles left, so they are finished
+	// soon and no isolated triangles are left behind
+	return score+2.f/std::sqrt(float(remaining));
+}
+
+}
+
+void optimizeVertexCache(Geometry &g) {
+	optimizeVertexCache(g.triangles,g.positions.size());
+	g.trianglesChanged();
+}
+
+void optimizeVertexCache(std::vector<int> &triangles, int nverts) {
+	int ntris = triangles.size()/3;
+	if (ntris==0) return;
+	const std::vector<int> &idx = triangles;
+	
+	// triangles using each vertex (CSR adjacency)
+	std::vector<int> first(nverts+1,0), adj(ntris*3);
+	for(int i : idx) ++first[i+1];
+	for(int v=0;v<nverts;++v) first[v+1] += first[v];
+	std::vector<int> remaining(nverts);
+	for(int v=0;v<nverts;++v) remaining[v] = first[v+1]-first[v];
+	{
+		std::vector<int> fill(first.begin(),first.end()-1);
+		for(int t=0;t<ntris;++t) 
+			for(int k=0;k<3;++k) 
+				adj[fill[idx[t*3+k]]++] = t;
+	}
+	
+	std::vector<int> cache_pos(nverts,-1);
+	std::vector<float> vscore(nverts), tscore(ntris);
+	for(int v=0;v<nverts;++v) vscore[v] = vertexScore(-1,remaining[v]);
+	for(int t=0;t<ntris;++t) tscore[t] = vscore[idx[t*3]]+vscore[idx[t*3+1]]+vscore[idx[t*3+2]];
+	std::vector<char> emitted(ntris,0);
+	
+	std::vector<int> out; out.reserve(idx.size());
+	std::vector<int> cache, new_cache; // vertexes, most recent first
+	cache.reserve(cache_size+3); new_cache.reserve(cache_size+3);
+	int best = std::max_element(tscore.begin(),tscore.end())-tscore.begin();
+	int next_unused = 0; // for restarting when the cache gives no candidate
+	
+	for(int emitted_count=0;emitted_count<ntris;++emitted_count) {
+		if (best==-1) { // no candidates in cache: take any triangle left
+			while (emitted[next_unused]) ++next_unused;
+			best = next_unused;
+		}
+		const int *tri = &idx[best*3];
+		out.insert(out.end(),tri,tri+3);
+		emitted[best] = 1;
+		
+		// remove it from its vertexes' adjacency (keeping the active ones first)
+		for(int k=0;k<3;++k) {
+			int v = tri[k];
+			int *a = &adj[first[v]], n = remaining[v];
+			std::size_t pos = std::find(a,a+n,best)-a;
+			cg_assert(pos<std::size_t(n),"Inconsistent vertex adjacency");
+			std::swap(a[pos],a[n-1]);
+			--remaining[v];
+		}
+		
+		// move its vertexes to the front of the cache
+		new_cache.clear();
+		for(int k=0;k<3;++k) // (degenerate triangles may repeat a vertex)
+			if (std::find(new_cache.begin(),new_cache.end(),tri[k])==new_cache.end())
+				new_cache.push_back(tri[k]);
+		for(int v : cache) 
+			if (v!=tri[0] and v!=tri[1] and v!=tri[2]) 
+				new_cache.push_back(v);
+		cache.swap(new_cache);
+		
+		// update scores of the vertexes in cache (and the ones just evicted),
+		// and of their triangles, looking for the next best triangle
+		for(std::size_t i=0;i<cache.size();++i) {
+			int v = cache[i];
+			cache_pos[v] = i<std::size_t(cache_size) ? int(i) : -1;
+			vscore[v] = vertexScore(cache_pos[v],remaining[v]);
+		}
+		best = -1; float best_score = -1.f;
+		for(int v : cache) {
+			for(int j=first[v],e=first[v]+remaining[v];j<e;++j) {
+				int t = adj[j];
+				const int *tv = &idx[t*3];
+				tscore[t] = vscore[tv[0]]+vscore[tv[1]]+vscore[tv[2]];
+				if (tscore[t]>best_score) { best_score = tscore[t]; best = t; }
+			}
+		}
+		if (cache.size()>std::size_t(cache_size)) cache.resize(cache_size);
+	}
+	
+	triangles.swap(out);
+}
+
+void optimizeVertexFetch(Geometry &g) {
+	int nverts = g.positions.size();
+	std::vector<int> remap(nverts,-1);
+	int next = 0;
+	for(int &i : g.triangles) {
+		if (remap[i]==-1) remap[i] = next++;
+		i = remap[i];
+	}
+	for(int &r : remap) 
+		if (r==-1) r = next++;
+	g.trianglesChanged();
+	
+	auto reorder = [&remap](auto &v) {
+		if (v.size()!=remap.size()) return;
+		auto aux = v;
+		for(std::size_t i=0;i<remap.size();++i) 
+			v[remap[i]] = aux[i];
+	};
+	reorder(g.positions); 
+	reorder(g.normals); 
+	reorder(g.tex_coords);
+}
+
+VertexCacheStats analyzeVertexCache(const Geometry &g, int cache_size) {
+	VertexCacheStats stats;
+	if (g.triangles.empty()) return stats;
+	std::vector<int> stamp(g.positions.size(),-cache_size-1);
+	std::vector<char> used(g.positions.size(),0);
+	int misses = 0, nused = 0;
+	for(int i : g.triangles) {
+		// FIFO: a vertex is in cache if it was added less than cache_size misses ago
+		if (misses-stamp[i]>cache_size) stamp[i] = misses++;
+		if (not used[i]) { used[i] = 1; ++nused; }
+	}
+	stats.acmr = float(misses)/(g.triangles.size()/3);
+	stats.atvr = float(misses)/nused;
+	return stats;
+}
+
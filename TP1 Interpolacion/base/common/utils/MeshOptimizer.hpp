@@ -0,0 +1,30 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include "Geometry.hpp"
+
+// Reorders the triangles so that consecutive triangles share as many 
+// vertexes as possible, and the GPU can reuse the results of the vertex 
+// shader from its post-transform cache (Forsyth's "Linear-Speed Vertex 
+// Cache Optimisation"). The mesh is the same, only the order changes.
+void optimizeVertexCache(Geometry &g);
+// same, for an index buffer alone (e.g. a range of a LOD chain)
+void optimizeVertexCache(std::vector<int> &triangles, int vertex_count);
+
+// Reorders the vertexes in the order they are first used by the triangles
+// (call it after optimizeVertexCache), so the vertex fetch reads memory
+// almost sequentially. Unused vertexes are moved to the end.
+void optimizeVertexFetch(Geometry &g);
+
+// Simulates a FIFO post-transform cache of the given size:
+//   acmr: average cache miss ratio, transformed vertexes per triangle 
+//         (between 0.5 for a perfect order and 3 for no reuse at all)
+//   atvr: average transformed vertex ratio, transformed vertexes per 
+//         used vertex (1 is optimal)
+struct VertexCacheStats {
+	float acmr = 0.f, atvr = 0.f;
+};
+VertexCacheStats analyzeVertexCache(const Geometry &g, int cache_size=16);
+
+#endif
+
@@ -0,0 +1,33 @@
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+#include <vector>
+#include <glm/vec3.hpp>
+#include "Geometry.hpp"
+
+// Simplifies a mesh by collapsing edges (one vertex moves onto a neighbour),
+// choosing the collapses with the smallest quadric error (Garland-Heckbert),
+// until it has at most target_index_count indexes or the next collapse 
+// would have an error greater than max_error. Errors are distances relative
+// to the size of the mesh (the diagonal of its bounding box). It returns a 
+// new index buffer for the same vertexes, which are not modified. Vertexes 
+// on seams (same position, different normal or texture coordinates) and on
+// borders are only collapsed along the seam or border (both sides of a seam
+// at the same time), so seams do not open and borders keep their shape.
+std::vector<int> simplify(const std::vector<glm::vec3> &positions, const std::vector<int> &triangles,
+						  std::size_t target_index_count, float max_error, float *result_error=nullptr);
+
+// a level of detail, as a range of Geometry::triangles
+struct LodLevel {
+	int first = 0, count = 0; // indexes
+	float error = 0.f; // relative to the size of the mesh (see simplify)
+};
+
+// Appends to g.triangles simplified versions of the mesh, each one with
+// about half the triangles of the previous one (while the error stays 
+// below max_error), and returns the ranges of all the levels (the first
+// one is the original mesh).
+std::vector<LodLevel> generateLods(Geometry &g, int max_levels=6, float max_error=0.05f);
+
+#endif
+
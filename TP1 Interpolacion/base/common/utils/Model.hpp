@@ -1,38 +1,144 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 #include <vector>
+#include <future>
+#include <functional>
+#include <memory>
+#include <string>
 #include "Geometry.hpp"
 #include "Material.hpp"
 #include "Texture.hpp"
+#include "MeshCache.hpp"
+#include "ObjMesh.hpp"
+#include "MeshSimplifier.hpp"
+#include "UniformBlocks.hpp"
 
-// auxiliar struct for loading all model-related data
+// CPU side of a model (everything but the GPU buffers and texture), so it 
+// can be loaded in another thread and turned into a Model later, in the 
+// thread that owns the OpenGL context
+struct ModelData {
+	Geometry geometry;
+	Material material;
+	int flags = 0;
+	std::vector<LodLevel> lods;
+	std::string key; // model and part, to share its buffers (empty if not shared)
+};
+
+// auxiliar struct for loading all model-related data; buffers and texture
+// are shared with other models loaded from the same part or image (see 
+// AssetCache) and never modified, the level of detail and the instances
+// are kept here (use draw and drawInstanced instead of the buffers' ones)
 struct Model {
 	Geometry geometry;
-	GeometryRenderer buffers;
+	std::shared_ptr<GeometryRenderer> buffers;
 	Material material;
-	Texture texture;
+	std::shared_ptr<Texture> texture; // null if untextured (or packed)
+	std::shared_ptr<TextureArray> texture_array; // instead of texture if packed (see fTextureArrays)
+	int texture_layer = 0; // its image in texture_array (also in material_buffer)
+	UniformBuffer material_buffer; // the material for the Material block (bind it to ubMaterial)
+	std::vector<LodLevel> lods; // ranges of geometry.triangles (see fLods)
+	int lod = 0; // current level (see setLod)
+	InstanceBuffer instances; // per instance model matrixes for drawInstanced
 	
 	Model() = default;
 	Model(const Geometry &g, const Material &m) 
-		: buffers(g), material(m), 
-		  texture(m.texture.empty() ? Texture() : Texture(m.texture))
+		: buffers(std::make_shared<GeometryRenderer>(g)), material(m), 
+		  texture(loadTexture(m.texture,0))
 	{
-		
+		material_buffer.update(MaterialBlock(material));
 	}
 	Model(Geometry &&g, const Material &m, bool keep_geometry=false) 
-		: buffers(g), material(m), 
-		  texture(m.texture.empty() ? Texture() : Texture(m.texture))
+		: buffers(std::make_shared<GeometryRenderer>(g)), material(m), 
+		  texture(loadTexture(m.texture,0))
 	{
+		material_buffer.update(MaterialBlock(material));
 		if (keep_geometry) geometry = std::move(g);
 	}
+	Model(ModelData &&d) 
+		: buffers(shareBuffers(d.key,d.flags,[&d]() { return GeometryRenderer(d.geometry,false,bufferFormat(d.flags)); })),
+		  material(d.material), texture(loadTexture(d.material.texture,d.flags)),
+		  lods(std::move(d.lods))
+	{
+		material_buffer.update(MaterialBlock(material));
+		if (d.flags&fKeepGeometry) geometry = std::move(d.geometry);
+		setLod(0);
+	}
+	// (only fKeepGeometry, fDynamic, fCompact, fInterleaved and the textures flags are used)
+	Model(const MeshCache::Part &p, int flags=0, const std::string &key="")
+		: buffers(shareBuffers(key,flags,[&p,flags]() { 
+				return GeometryRenderer(p.positions,p.normals,p.tex_coords,p.vertex_count,p.triangles,p.index_count,false,bufferFormat(flags)); 
+		  })), 
+		  material(p.material), texture(loadTexture(p.material.texture,flags))
+	{
+		material_buffer.update(MaterialBlock(material));
+		if (flags&fKeepGeometry) geometry = p.toGeometry();
+		lods = p.lods;
+		setLod(0);
+	}
 	
 	enum Flags { fNone=0, fDontFit=1, fKeepGeometry=2, 
-				 fRegenerateNormals=4, fDynamic=8 };
+				 fRegenerateNormals=4, 
+				 fDynamic=8, // vertexes will be updated every frame (GeometryRenderer's fStream)
+				 fNoTextures=16, 
+				 fNoCache=32, // don't read nor write the binary mesh and texture caches
+				 fOptimize=64, // reorder triangles and vertexes for the GPU caches (see MeshOptimizer)
+				 fLods=128, // generate simplified versions (all of them in the same buffers, see MeshSimplifier)
+				 fCompact=256, // upload quantized vertexes (see VertexQuantization), shaders must decode them
+				 fInterleaved=512, // upload all the vertex attributes in a single buffer (see GeometryRenderer)
+				 fAsyncTextures=1024, // decode and upload textures in the background (see TextureUploader)
+				 fCompressTextures=2048, // BC1/BC3 textures (see TextureCache)
+				 fTextureArrays=4096, // only for load: pack the textures of all the parts (see packTextures)
+				 fStreamedTextures=8192 // only the levels needed on screen are resident (see TextureResidency)
+	};
+	static int bufferFormat(int flags) { // GeometryRenderer's format for these flags
+		return (flags&fCompact ? GeometryRenderer::fCompact : 0) | (flags&fInterleaved ? GeometryRenderer::fInterleaved : 0)
+			 | (flags&fDynamic ? GeometryRenderer::fStream : 0);
+	}
+	// the texture from the AssetCache (null if fname is empty, or with fTextureArrays)
+	static std::shared_ptr<Texture> loadTexture(const std::string &fname, int flags);
+	// buffers from the AssetCache (create is called only the first time), 
+	// or new ones if key is empty or they may change (fDynamic, fKeepGeometry)
+	static std::shared_ptr<GeometryRenderer> shareBuffers(const std::string &key, int flags, 
+	                                                      const std::function<GeometryRenderer()> &create);
+	static int textureFlags(int flags) { // Texture's flags for these flags
+		return (flags&fAsyncTextures ? Texture::fAsync : 0) | (flags&fNoCache ? Texture::fNoCache : 0)
+			 | (flags&fCompressTextures ? Texture::fCompress : 0) | (flags&fStreamedTextures ? Texture::fStreamed : 0);
+	}
+	
+	// draws only the given level of detail (0 is the full mesh)
+	void setLod(int level);
+	// range of indexes of the current level of detail
+	int drawFirst() const { return lods.empty() ? buffers->drawFirst() : lods[lod].first; }
+	int drawCount() const { return lods.empty() ? buffers->drawCount() : lods[lod].count; }
+	void draw() const { buffers->draw(drawFirst(),drawCount()); }
+	// bind them with shader.setBuffers(*buffers,instances)
+	void setInstanceMatrixes(const std::vector<glm::mat4> &matrixes) { instances.update(matrixes); }
+	void drawInstanced() const { buffers->drawInstanced(instances.count(),drawFirst(),drawCount()); }
+	// chooses (and sets) the coarsest level whose error, projected on the
+	// screen, is at most max_pixel_error pixels; screen_size is the size 
+	// in pixels of the diagonal of the model's bounding box (see projectedSize)
+	int selectLod(float screen_size, float max_pixel_error = 1.f);
+	
 	static std::vector<Model> load(const std::string &name, int flags = 0);
+	// groups the images of these models by size and format, and uploads each
+	// group as a TextureArray (from the AssetCache); the models use it (with 
+	// their layer) instead of texture, so the ones that share an array can be
+	// drawn in a row without binding another texture (use textureArray.frag)
+	static void packTextures(std::vector<Model> &models, int flags = 0);
 	static Model loadSingle(const std::string &name, int flags = 0);
+	// same as loadSingle, but without touching OpenGL, so it can run in any
+	// thread; loadSingleAsync runs it in the shared ThreadPool (use the 
+	// future's result to construct the Model in the main thread)
+	static ModelData loadSingleData(const std::string &name, int flags = 0);
+	static std::future<ModelData> loadSingleAsync(const std::string &name, int flags = 0);
+	// loads only one part (only that part is parsed, see ObjIndex); the 
+	// overload with an index avoids scanning the file again for each part
+	static Model loadPart(const std::string &name, const std::string &part_name, int flags = 0);
+	static Model loadPart(const ObjIndex &index, const std::string &part_name, int flags = 0);
 };
 
 void centerAndResize(std::vector<glm::vec3> &v);
+void centerAndResize(std::vector<glm::vec3> &v, const std::pair<glm::vec3,glm::vec3> &bb); // with a given bounding box
 
 #endif
 
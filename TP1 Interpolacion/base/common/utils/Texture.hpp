@@ -1,24 +1,168 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <future>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
+#include "TextureCache.hpp"
+
+// decodes an image, or reads it from its cache (see TextureCache.hpp); with
+// use_cache the first time it also generates the mipmaps and saves them; it
+// does not touch OpenGL, so it can run in any thread
+TextureImage loadTextureImage(const std::string &fname, bool use_cache=true, bool compress=false);
 
 class Texture {
 public:
+	enum Flags { fAsync=1, // decode in the shared ThreadPool and upload in TextureUploader::update
+				 fNoCache=2, // don't read nor write the cache with the mipmaps
+				 fCompress=4, // BC1/BC3 compression (if the driver supports S3TC)
+				 fStreamed=8 // upload only its smallest levels, TextureResidency streams the others
+	};
 	Texture() = default;
-	Texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true);
+	// with fAsync the texture shows a 1x1 gray placeholder until it is
+	// uploaded, but it can be bound and used as usual
+	Texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true, int flags=0);
 	Texture(Texture &&t);
 	Texture &operator=(Texture &&t);
 	~Texture();
 	void bind(int number=0) const;
-	bool isOk() const { return channels!=-1; }
+	bool isOk() const { return id!=0; }
+	bool isLoaded() const; // false while an async load is not finished
+	GLuint getId() const { return id; }
+	std::size_t memorySize() const; // GPU bytes, with its mipmaps (0 if fAsync and not decoded yet; resident levels if fStreamed)
 private:
 	Texture &operator=(const Texture &t) = default;
 	GLuint id = 0;
-	int width=-1, height=-1, channels=-1;
+	int width=-1, height=-1, channels=-1; // (unknown with async)
+	std::size_t memory_size = 0;
+	bool repeat_s=true, repeat_t=true, async=false, streamed=false;
+};
+
+// GL_TEXTURE_2D_ARRAY with one image per layer, so parts with different
+// images can be drawn without binding another texture (the shader picks the
+// layer, see shaders/textureArray.frag). Every image must have the same
+// size, format and levels (see compatible). It is loaded synchronously.
+class TextureArray {
+public:
+	TextureArray() = default;
+	TextureArray(const std::vector<TextureImage> &images, bool repeat_s=true, bool repeat_t=true);
+	// loads the images in parallel (only fNoCache and fCompress are used)
+	TextureArray(const std::vector<std::string> &fnames, bool repeat_s=true, bool repeat_t=true, int flags=0);
+	TextureArray(TextureArray &&t);
+	TextureArray &operator=(TextureArray &&t);
+	~TextureArray();
+	void bind(int number=0) const;
+	bool isOk() const { return id!=0; }
+	GLuint getId() const { return id; }
+	int layersCount() const { return layers; }
+	std::size_t memorySize() const { return memory_size; } // GPU bytes, with its mipmaps
+	// true if both images can be layers of the same array
+	static bool compatible(const TextureImage &a, const TextureImage &b);
+private:
+	TextureArray &operator=(const TextureArray &t) = default;
+	GLuint id = 0;
+	int width=-1, height=-1, layers=0;
+	std::size_t memory_size = 0;
 	bool repeat_s=true, repeat_t=true;
 };
 
+// Finishes the textures loaded with fAsync. update() must be called
+// from the thread that owns the OpenGL context (once per frame, for
+// instance). For each decoded image it copies at most budget bytes of rows
+// into a pixel buffer object and uploads them from there, so a big texture
+// is spread over several frames instead of stalling one. Levels go from the
+// smallest to the biggest one, and each one is used as soon as it is
+// complete; if the image has no mipmaps (fNoCache), the placeholder stays
+// until level 0 is complete and then the mipmaps are generated.
+class TextureUploader {
+public:
+	static TextureUploader &shared();
+
+	// returns how many textures are still loading
+	int update(std::size_t budget = 4<<20);
+	void finishAll(); // waits for every image and uploads all of them
+	bool isLoading(GLuint texture_id) const;
+	std::size_t memorySize(GLuint texture_id) const; // 0 if not decoded yet
+	int pending() const { return static_cast<int>(jobs.size()); }
+
+	~TextureUploader();
+private:
+	friend class Texture;
+	TextureUploader() = default;
+	TextureUploader(const TextureUploader &) = delete;
+	TextureUploader &operator=(const TextureUploader &) = delete;
+	void add(GLuint texture_id, std::future<TextureImage> &&image);
+	void cancel(GLuint texture_id);
+	struct Job {
+		GLuint texture_id;
+		std::future<TextureImage> decoding;
+		TextureImage image; // once decoded
+		int level = -1, next_row = 0; // (rows of blocks if compressed)
+	};
+	bool upload(Job &job, std::size_t &budget); // true when it is done
+	std::vector<Job> jobs;
+	std::unordered_map<GLuint,std::size_t> sizes; // of the decoded images
+	GLuint pbo = 0;
+};
+
+// Keeps the textures loaded with fStreamed under a GPU memory budget. When
+// they are created only their smallest levels (up to 64x64) are uploaded.
+// request() tells how big a texture is on screen in this frame, and
+// update() (once per frame, after the requests) picks for each one the
+// finest level it needs and uploads the missing ones, moving
+// GL_TEXTURE_BASE_LEVEL (as MIN_FILTER is GL_LINEAR, that is the level
+// sampled). Levels that are not needed anymore stay until the budget is
+// exceeded; then those are freed first, then the ones of the textures that
+// were not requested lately, the biggest level first. The levels come from
+// the image cache, which stays mapped, so streaming a level in is just one
+// upload.
+class TextureResidency {
+public:
+	static TextureResidency &shared();
+	
+	// screen_size: pixels covered on screen by the whole image (its largest
+	// side, see projectedSize); with several requests in a frame the biggest wins
+	void request(const Texture &texture, float screen_size);
+	// uploads at most upload_budget bytes of levels (but at least one level)
+	void update(std::size_t upload_budget = 4<<20);
+	void setBudget(std::size_t bytes) { budget = bytes; } // (default 256 MB)
+	std::size_t getBudget() const { return budget; }
+	std::size_t memorySize(GLuint texture_id) const; // resident bytes (0 if not decoded yet)
+	bool isLoading(GLuint texture_id) const; // still decoding (fAsync)
+	
+	struct Stats {
+		int textures = 0;
+		std::size_t resident_bytes = 0, needed_bytes = 0, full_bytes = 0; // (full: with every level)
+		int loaded_levels = 0, dropped_levels = 0; // in the last update
+	};
+	const Stats &stats() const { return last_stats; }
+	
+private:
+	friend class Texture;
+	TextureResidency() = default;
+	TextureResidency(const TextureResidency &) = delete;
+	TextureResidency &operator=(const TextureResidency &) = delete;
+	void add(GLuint texture_id, std::future<TextureImage> &&image);
+	void add(GLuint texture_id, TextureImage &&image);
+	void remove(GLuint texture_id) { entries.erase(texture_id); }
+	struct Entry {
+		std::future<TextureImage> decoding;
+		TextureImage image; // once decoded, with every level
+		int base = 0, tail = 0; // finest resident level, and first of the ones always resident
+		int needed = 0, wanted = 0; // (in this update)
+		float screen_size = 0.f; // biggest request of this frame
+		std::uint64_t last_request = 0;
+	};
+	void makeResident(GLuint texture_id, Entry &e); // uploads the tail of a decoded image
+	std::unordered_map<GLuint,Entry> entries;
+	std::size_t budget = 256<<20;
+	std::uint64_t frame = 1;
+	Stats last_stats;
+};
+
 #endif
 
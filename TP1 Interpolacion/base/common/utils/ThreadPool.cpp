@@ -0,0 +1,45 @@
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(int nthreads) {
+	if (nthreads<=0) nthreads = std::max(1u,std::thread::hardware_concurrency());
+	for(int i=0;i<nthreads;++i) {
+		workers.emplace_back([this]() {
+			while(true) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock,[this]{ return stopping or not tasks.empty(); });
+					if (tasks.empty()) return; // stopping
+					task = std::move(tasks.front());
+					tasks.pop();
+				}
+				task();
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	for(std::thread &t : workers) 
+		t.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(task));
+	}
+	cv.notify_one();
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads consuming a queue of tasks
+class ThreadPool {
+public:
+	ThreadPool(int nthreads=0); // 0 means one per hardware thread
+	~ThreadPool();
+	
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	
+	int size() const { return static_cast<int>(workers.size()); }
+	
+	// queues f to be run by some worker, the future gets its result
+	template<typename F>
+	auto submit(F &&f) -> std::future<decltype(f())>;
+	
+	// runs f(i) for every i in [0;n) and waits for all of them; the calling
+	// thread also takes items, so it is safe to call it from inside a task
+	// of the same pool (if all workers are busy, the caller does everything)
+	template<typename F>
+	void parallelFor(int n, F &&f);
+	
+	// pool shared by all utils (lazily created on first use)
+	static ThreadPool &shared();
+	
+private:
+	void enqueue(std::function<void()> task);
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+};
+
+template<typename F>
+auto ThreadPool::submit(F &&f) -> std::future<decltype(f())> {
+	using R = decltype(f());
+	auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+	std::future<R> result = task->get_future();
+	enqueue([task](){ (*task)(); });
+	return result;
+}
+
+template<typename F>
+void ThreadPool::parallelFor(int n, F &&f) {
+	if (n<=0) return;
+	if (n==1 or workers.empty()) { 
+		for(int i=0;i<n;++i) f(i); 
+		return; 
+	}
+	struct State {
+		std::atomic<int> next{0}, done{0};
+		std::mutex mutex;
+		std::condition_variable cv;
+	};
+	auto state = std::make_shared<State>();
+	// helpers may start after this function returns, so they only keep 
+	// the shared state and never touch f once all items were taken
+	auto work = [state,n,&f]() {
+		for(int i; (i=state->next.fetch_add(1))<n; ) {
+			f(i);
+			if (state->done.fetch_add(1)+1==n) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->cv.notify_all();
+			}
+		}
+	};
+	int nhelpers = std::min(size(),n-1);
+	for(int i=0;i<nhelpers;++i) 
+		enqueue([state,n,work]() { if (state->next.load()<n) work(); });
+	work();
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cv.wait(lock,[&]{ return state->done.load()==n; });
+}
+
+#endif
+
@@ -0,0 +1,44 @@
+#ifndef VERTEX_ADJACENCY_HPP
+#define VERTEX_ADJACENCY_HPP
+
+#include <vector>
+
+// Triangles around each vertex of an indexed mesh, in CSR form: all the 
+// lists together in a single array, plus the position where each one 
+// starts (so there are no per-vertex allocations). Each vertex's triangles
+// are sorted. Triangle t is triangles[3*t], triangles[3*t+1], triangles[3*t+2].
+class VertexAdjacency {
+public:
+	// a list of triangles, to use in range-based for loops
+	struct Range {
+		const int *b, *e;
+		const int *begin() const { return b; }
+		const int *end() const { return e; }
+		int size() const { return static_cast<int>(e-b); }
+	};
+	
+	VertexAdjacency() = default;
+	// builds it (in parallel for big meshes)
+	VertexAdjacency(const std::vector<int> &triangles, int vertex_count);
+	
+	bool empty() const { return first.empty(); }
+	int vertexCount() const { return empty() ? 0 : static_cast<int>(first.size())-1; }
+	int indexCount() const { return static_cast<int>(tris.size()); }
+	
+	Range trianglesAround(int v) const { return { tris.data()+first[v], tris.data()+first[v+1] }; }
+	int degree(int v) const { return first[v+1]-first[v]; }
+	
+	// vertexes sharing a triangle with v (but v), sorted and without repetitions;
+	// ring is cleared and refilled, so reusing the same vector for many 
+	// queries avoids allocations
+	void oneRing(int v, const std::vector<int> &triangles, std::vector<int> &ring) const;
+	// vertexes of all the triangles around the given ones (including them)
+	void oneRing(const std::vector<int> &vertexes, const std::vector<int> &triangles, std::vector<int> &ring) const;
+	
+private:
+	std::vector<int> first; // vertex_count+1 elements
+	std::vector<int> tris;
+};
+
+#endif
+
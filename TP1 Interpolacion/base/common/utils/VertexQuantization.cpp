@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cmath>
+#include "VertexQuantization.hpp"
+
+namespace {
+
+inline std::uint16_t toUnorm16(float v) { // v in [0,1]
+	return static_cast<std::uint16_t>(std::lround(std::min(1.f,std::max(0.f,v))*65535.f));
+}
+
+inline std::int16_t toSnorm16(float v) { // v in [-1,1]
+	return static_cast<std::int16_t>(std::lround(std::min(1.f,std::max(-1.f,v))*32767.f));
+}
+
+inline float signNotZero(float v) { return v<0.f ? -1.f : 1.f; }
+
+}
+
+glm::vec2 octahedralEncode(const glm::vec3 &n) {
+	float l1 = std::fabs(n.x)+std::fabs(n.y)+std::fabs(n.z);
+	if (l1==0.f) return {0.f,0.f};
+	glm::vec2 e = {n.x/l1, n.y/l1};
+	if (n.z<0.f) // fold the lower hemisphere over the diagonals
+		e = { (1.f-std::fabs(e.y))*signNotZero(e.x), (1.f-std::fabs(e.x))*signNotZero(e.y) };
+	return e;
+}
+
+glm::vec3 octahedralDecode(const glm::vec2 &e) {
+	glm::vec3 n = {e.x, e.y, 1.f-std::fabs(e.x)-std::fabs(e.y)};
+	if (n.z<0.f) {
+		float x = n.x;
+		n.x = (1.f-std::fabs(n.y))*signNotZero(x);
+		n.y = (1.f-std::fabs(x))*signNotZero(n.y);
+	}
+	float len = std::sqrt(n.x*n.x+n.y*n.y+n.z*n.z);
+	return {n.x/len, n.y/len, n.z/len};
+}
+
+void quantizePositions(const glm::vec3 *positions, int count, std::vector<std::uint16_t> &out, VertexDecode &decode) {
+	out.resize(std::size_t(count)*4);
+	if (count==0) return;
+	glm::vec3 pmin = positions[0], pmax = positions[0];
+	for(int i=0;i<count;++i) {
+		for(int j=0;j<3;++j) {
+			pmin[j] = std::min(pmin[j],positions[i][j]);
+			pmax[j] = std::max(pmax[j],positions[i][j]);
+		}
+	}
+	decode.position_offset = pmin;
+	decode.position_scale = pmax-pmin;
+	glm::vec3 inv;
+	for(int j=0;j<3;++j) 
+		inv[j] = decode.position_scale[j]>0.f ? 1.f/decode.position_scale[j] : 0.f;
+	for(int i=0;i<count;++i) {
+		for(int j=0;j<3;++j) 
+			out[i*4+j] = toUnorm16((positions[i][j]-pmin[j])*inv[j]);
+		out[i*4+3] = 0;
+	}
+}
+
+void quantizeTexCoords(const glm::vec2 *tex_coords, int count, std::vector<std::uint16_t> &out, VertexDecode &decode) {
+	out.resize(std::size_t(count)*2);
+	if (count==0) return;
+	glm::vec2 tmin = tex_coords[0], tmax = tex_coords[0];
+	for(int i=0;i<count;++i) {
+		for(int j=0;j<2;++j) {
+			tmin[j] = std::min(tmin[j],tex_coords[i][j]);
+			tmax[j] = std::max(tmax[j],tex_coords[i][j]);
+		}
+	}
+	// most models use [0,1], so keep it when possible (0 and 1 stay exact)
+	for(int j=0;j<2;++j) {
+		if (tmin[j]>=0.f and tmax[j]<=1.f) { tmin[j] = 0.f; tmax[j] = 1.f; }
+	}
+	decode.tex_coords_offset = tmin;
+	decode.tex_coords_scale = tmax-tmin;
+	glm::vec2 inv;
+	for(int j=0;j<2;++j) 
+		inv[j] = decode.tex_coords_scale[j]>0.f ? 1.f/decode.tex_coords_scale[j] : 0.f;
+	for(int i=0;i<count;++i)
+		for(int j=0;j<2;++j) 
+			out[i*2+j] = toUnorm16((tex_coords[i][j]-tmin[j])*inv[j]);
+}
+
+void encodeNormals(const glm::vec3 *normals, int count, std::vector<std::int16_t> &out, VertexDecode &decode) {
+	out.resize(std::size_t(count)*2);
+	decode.octahedral_normals = true;
+	for(int i=0;i<count;++i) {
+		glm::vec2 e = octahedralEncode(normals[i]);
+		out[i*2] = toSnorm16(e.x); out[i*2+1] = toSnorm16(e.y);
+	}
+}
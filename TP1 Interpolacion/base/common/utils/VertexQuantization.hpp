@@ -0,0 +1,36 @@
+#ifndef VERTEX_QUANTIZATION_HPP
+#define VERTEX_QUANTIZATION_HPP
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+// Compact vertex format (GeometryRenderer::fCompact, alone or with
+// fInterleaved and fStream), 16 bytes per vertex instead of 32, and 2 bytes
+// per index instead of 4:
+//   positions:  4 x uint16, normalized, relative to the bounding box (the 
+//               4th one is just padding, to keep vertexes 4-byte aligned)
+//   normals:    2 x int16, normalized, octahedral encoding
+//   tex_coords: 2 x uint16, normalized, relative to their bounding box
+//   indexes:    uint16 if there are at most 65536 vertexes
+// The vertex shader undoes the scales and offsets and decodes the normals
+// (see shaders/funcs/vertexDecode.vert), with the uniforms that 
+// Shader::setBuffers takes from this struct.
+struct VertexDecode {
+	glm::vec3 position_offset = {0.f,0.f,0.f}, position_scale = {1.f,1.f,1.f};
+	glm::vec2 tex_coords_offset = {0.f,0.f}, tex_coords_scale = {1.f,1.f};
+	bool octahedral_normals = false;
+};
+
+// each one fills the buffer (resizing it) and the part of decode that
+// corresponds to that attribute
+void quantizePositions(const glm::vec3 *positions, int count, std::vector<std::uint16_t> &out, VertexDecode &decode);
+void quantizeTexCoords(const glm::vec2 *tex_coords, int count, std::vector<std::uint16_t> &out, VertexDecode &decode);
+void encodeNormals(const glm::vec3 *normals, int count, std::vector<std::int16_t> &out, VertexDecode &decode);
+
+// octahedral encoding of a unit vector in [-1,1]^2, and its inverse
+glm::vec2 octahedralEncode(const glm::vec3 &n);
+glm::vec3 octahedralDecode(const glm::vec2 &e);
+
+#endif
@@ -2,6 +2,9 @@
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <future>
+#include <chrono>
+#include <cmath>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -11,13 +14,17 @@
 #include "Callbacks.hpp"
 #include "Debug.hpp"
 #include "Shaders.hpp"
+#include "Misc.hpp"
+#include "UniformBlocks.hpp"
+#include "AssetCache.hpp"
 
 #define VERSION 20220816
 
 // models and settings
 std::vector<std::string> models_names = { "suzanne", "chookity", "teapot" };
 int current_model = 0;
-bool rotate = true, wireframe = false, enable_texture = true;
+bool rotate = true, wireframe = false, enable_texture = true, auto_lod = true;
+float lod_pixel_error = 1.f; // max. error allowed for a level of detail, in pixels
 
 // extraa callbacks
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
@@ -32,56 +39,85 @@ int main() {
 	// setup OpenGL state and load shaders
 	glEnable(GL_DEPTH_TEST); glDepthFunc(GL_LESS); 
 	glClearColor(0.3f,0.3f,0.4f,1.f);
-	Shader shader_texture("shaders/texture"),
-		   shader_phong("shaders/phong"),
-		   shader_wire("shaders/wireframe");
+	Shader shader_texture, shader_phong, shader_wire; // compiled at the same time (see loadDeferred)
+	shader_texture.loadDeferred("shaders/texture");
+	shader_phong.loadDeferred("shaders/phong");
+	shader_wire.loadDeferred("shaders/wireframe");
 	
 	// main loop
-	Model model;
-	int loaded_model = -1;
+	Model model = Model::loadSingle(models_names[current_model],Model::fLods|Model::fCompact|Model::fInterleaved|Model::fAsyncTextures);
+	int loaded_model = current_model, loading_model = -1;
+	std::future<ModelData> next_model;
 	FrameTimer ftime;
+	UniformBuffer camera_buffer; // view, projection and light, shared by all the shaders
 	do {
 		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
-		// reload model if necessary
-		if (loaded_model!=current_model) { 
-			model = Model::loadSingle(models_names[current_model]);
-			loaded_model = current_model;
+		// reload model if necessary (parsed in background, the old one
+		// is drawn until the new one is ready)
+		if (loaded_model!=current_model and not next_model.valid()) { 
+			next_model = Model::loadSingleAsync(models_names[current_model],Model::fLods|Model::fCompact|Model::fInterleaved|Model::fAsyncTextures);
+			loading_model = current_model;
 		}
+		if (next_model.valid() and next_model.wait_for(std::chrono::seconds(0))==std::future_status::ready) {
+			model = Model(next_model.get());
+			loaded_model = loading_model;
+		}
+		TextureUploader::shared().update(); // (textures are decoded in background too)
 		
 		// auto-rotate
 		double dt = ftime.newFrame();
 		if (rotate) model_angle += static_cast<float>(1.f*dt);
 		
+		// level of detail, by the size of the model on screen (the 
+		// model is fitted in [-1,1]^3, so its diagonal is at most 2*sqrt(3))
+		float screen_size = projectedSize(2.f*std::sqrt(3.f),glm::length(view_pos),
+										  glm::radians(view_fov),win_height);
+		int lod = 0;
+		if (auto_lod) lod = model.selectLod(screen_size,lod_pixel_error);
+		else model.setLod(0);
+		
 		// select a shader
 		Shader &shader = [&]()->Shader&{
 			if (wireframe) return shader_wire;
-			if (enable_texture and model.texture.isOk()) {
-				model.texture.bind();
+			if (enable_texture and model.texture and model.texture->isOk()) {
+				model.texture->bind();
 				return shader_texture;
 			}
 			return shader_phong;
 		}();
 		shader.use();
-		setMatrixes(shader);
 		
-		// setup light and material
-		shader.setLight(glm::vec4{-1.f,1.f,4.f,1.f}, glm::vec3{1.f,1.f,1.f}, 0.35f);
-		shader.setMaterial(model.material);
+		// camera and light (once per frame, for every shader), model matrix
+		auto ms = common_callbacks::getMatrixes();
+		camera_buffer.update(CameraBlock{ms[1],ms[2],glm::vec4{-1.f,1.f,4.f,1.f},glm::vec3{1.f,1.f,1.f},0.35f});
+		camera_buffer.bind(ubCamera);
+		shader.setModelMatrix(ms[0],ms[1]);
+		
+		// material
+		model.material_buffer.bind(ubMaterial);
 		
 		// send geometry
-		shader.setBuffers(model.buffers);
+		shader.setBuffers(*model.buffers);
 		glPolygonMode(GL_FRONT_AND_BACK,wireframe?GL_LINE:GL_FILL);
-		model.buffers.draw();
+		model.draw();
 		
 		// settings sub-window
 		window.ImGuiDialog("CG Example",[&](){
 			ImGui::Combo(".obj (O)", &current_model,models_names);		
+			if (next_model.valid()) ImGui::Text("Loading %s...",models_names[loading_model].c_str());
 			ImGui::Checkbox("Auto-rotate (R)",&rotate);
 			ImGui::Checkbox("Wireframe (W)",&wireframe);
-			if (model.texture.isOk())
+			if (not model.lods.empty()) {
+				ImGui::Checkbox("Levels of detail (L)",&auto_lod);
+				if (auto_lod) ImGui::SliderFloat("Max. error (px)",&lod_pixel_error,0.5f,20.f);
+				ImGui::Text("LOD %d: %d triangles",lod,model.lods[lod].count/3);
+			}
+			if (model.texture and model.texture->isOk())
 				ImGui::Checkbox("Use textures (T)",&enable_texture);
+			AssetCache::Stats assets = AssetCache::shared().stats(); // (previous models are kept there)
+			ImGui::Text("Assets: %d textures, %d buffers, %.1f MB unused",assets.textures,assets.geometries,assets.unused_bytes/1048576.f);
 		});
 		
 		// finish frame
@@ -97,6 +133,7 @@ void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, i
 		case 'R': rotate = !rotate; break;
 		case 'W': wireframe = !wireframe; break;
 		case 'T': enable_texture = !enable_texture; break;
+		case 'L': auto_lod = !auto_lod; break;
 		case 'O': case 'M': current_model = (current_model+1)%models_names.size(); break;
 		}
 	}
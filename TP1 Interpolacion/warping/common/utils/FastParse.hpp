@@ -0,0 +1,128 @@
+#ifndef FAST_PARSE_HPP
+#define FAST_PARSE_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// Locale-independent parsing of numbers from a [p;end) range of chars (that
+// does not need to be null-terminated). On success, p is advanced past the 
+// number and the result is exactly the same that strtof/strtol would return
+// in the "C" locale. On failure (no digits, or inf/nan/hexadecimal values,
+// which are not supported) p is not modified. Leading blanks are not 
+// skipped, the caller must do that.
+
+bool parseInt(const char *&p, const char *end, int &value);
+bool parseFloat(const char *&p, const char *end, float &value);
+
+namespace fast_parse_detail {
+	
+	// slow but exact path for the cases that the fast path can not round 
+	// correctly (too many digits, huge exponents, halfway cases...)
+	bool parseFloatFallback(const char *&p, const char *end, float &value);
+	
+	// SWAR: checks and converts 8 ascii digits at once, reading them as 
+	// a single 64-bit little-endian word
+	inline bool isEightDigits(std::uint64_t w) {
+		return (((w & 0xF0F0F0F0F0F0F0F0ull) | 
+				 (((w + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) 
+				 == 0x3333333333333333ull);
+	}
+	inline std::uint32_t parseEightDigits(std::uint64_t w) {
+		w = ((w & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+		w = ((w & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+		return static_cast<std::uint32_t>(((w & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+	}
+	
+	// accumulates up to 19 significant digits in m, counts the rest in 
+	// dropped; returns the number of digits consumed
+	inline int readDigits(const char *&p, const char *end, std::uint64_t &m, int &nd, int &dropped) {
+		const char *p0 = p;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+		while (end-p>=8 and nd<=11) {
+			std::uint64_t w; std::memcpy(&w,p,8);
+			if (not isEightDigits(w)) break;
+			m = m*100000000u + parseEightDigits(w);
+			if (m) nd += 8;
+			p += 8;
+		}
+#endif
+		for(;p!=end and static_cast<unsigned>(*p-'0')<10u;++p) {
+			if (nd<19) { 
+				m = m*10u + static_cast<unsigned>(*p-'0');
+				if (m) ++nd;
+			} else
+				++dropped;
+		}
+		return static_cast<int>(p-p0);
+	}
+	
+}
+
+inline bool parseInt(const char *&p, const char *end, int &value) {
+	const char *q = p;
+	bool neg = false;
+	if (q!=end and (*q=='-' or *q=='+')) neg = *(q++)=='-';
+	if (q==end or static_cast<unsigned>(*q-'0')>=10u) return false;
+	long long r = 0;
+	for(;q!=end and static_cast<unsigned>(*q-'0')<10u;++q)
+		if (r<(1ll<<40)) r = r*10 + (*q-'0');
+	value = static_cast<int>(neg ? -r : r);
+	p = q;
+	return true;
+}
+
+inline bool parseFloat(const char *&p, const char *end, float &value) {
+	using namespace fast_parse_detail;
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	
+	const char *q = p;
+	bool neg = false;
+	if (q!=end and (*q=='-' or *q=='+')) neg = *(q++)=='-';
+	
+	// mantissa (digits that do not fit in m are dropped, and then the 
+	// fast path is discarded)
+	std::uint64_t m = 0; int nd = 0, dropped = 0;
+	int ndigits = readDigits(q,end,m,nd,dropped), exp10 = dropped;
+	if (q!=end and *q=='.') {
+		++q; int dropped_int = dropped;
+		int frac_digits = readDigits(q,end,m,nd,dropped);
+		exp10 -= frac_digits-(dropped-dropped_int);
+		ndigits += frac_digits;
+	}
+	if (ndigits==0) return false; // not a decimal number
+	
+	// exponent
+	if (q!=end and (*q=='e' or *q=='E')) {
+		const char *e = q+1; bool eneg = false;
+		if (e!=end and (*e=='-' or *e=='+')) eneg = *(e++)=='-';
+		if (e!=end and static_cast<unsigned>(*e-'0')<10u) {
+			int ev = 0;
+			for(;e!=end and static_cast<unsigned>(*e-'0')<10u;++e) 
+				if (ev<10000) ev = ev*10 + (*e-'0');
+			exp10 += eneg ? -ev : ev;
+			q = e;
+		}
+	}
+	
+	if (m==0) {
+		value = neg ? -0.f : 0.f;
+	} else {
+		// Clinger's fast path: m and 10^|exp10| are exact doubles, so d is
+		// correctly rounded; then (float)d is also correct unless d falls 
+		// exactly halfway between two floats (double rounding)
+		if (dropped or m>(1ull<<53) or exp10<-22 or exp10>22)
+			return parseFloatFallback(p,end,value);
+		double d = static_cast<double>(m);
+		d = exp10<0 ? d/pow10[-exp10] : d*pow10[exp10];
+		std::uint64_t bits; std::memcpy(&bits,&d,8);
+		if ((bits&0x1FFFFFFFull)==0x10000000ull or d<1.17549435e-38 or d>3.40282346e38)
+			return parseFloatFallback(p,end,value);
+		value = static_cast<float>(neg ? -d : d);
+	}
+	p = q;
+	return true;
+}
+
+#endif
+
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+
+// read-only view of a whole file mapped into memory (mmap on posix, 
+// MapViewOfFile on windows); the contents are NOT null-terminated
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const std::string &fname);
+	MappedFile(MappedFile &&f);
+	MappedFile &operator=(MappedFile &&f);
+	~MappedFile();
+	
+	bool isOk() const { return ok; }
+	const char *begin() const { return data_ptr; }
+	const char *end() const { return data_ptr+data_size; }
+	std::size_t size() const { return data_size; }
+	
+private:
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = default;
+	void freeResources();
+	const char *data_ptr = nullptr;
+	std::size_t data_size = 0;
+	bool ok = false;
+#ifdef _WIN32
+	void *file_handle = nullptr, *map_handle = nullptr;
+#endif
+};
+
+#endif
+
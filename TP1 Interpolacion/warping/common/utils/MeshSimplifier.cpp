@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <glm/glm.hpp>
+#include "MeshSimplifier.hpp"
+#include "VertexAdjacency.hpp"
+#include "Misc.hpp"
+
+namespace {
+
+// quadric error: weighted sum of squared distances to a set of planes,
+// stored as the symmetric 4x4 matrix, and the sum of the weights
+struct Quadric {
+	double a00=0, a01=0, a02=0, a11=0, a12=0, a22=0, b0=0, b1=0, b2=0, c=0, w=0;
+	void addPlane(const glm::vec3 &n, const glm::vec3 &p, double weight) { // unit normal and a point
+		double x = n.x, y = n.y, z = n.z, d = -glm::dot(n,p);
+		a00 += weight*x*x; a01 += weight*x*y; a02 += weight*x*z;
+		a11 += weight*y*y; a12 += weight*y*z; a22 += weight*z*z;
+		b0 += weight*x*d;  b1 += weight*y*d;  b2 += weight*z*d;
+		c += weight*d*d;   w += weight;
+	}
+	Quadric &operator+=(const Quadric &q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c; w += q.w;
+		return *this;
+	}
+	// mean squared distance from p to the planes
+	double eval(const glm::vec3 &p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double r = a00*x*x + a11*y*y + a22*z*z + 2*(a01*x*y + a02*x*z + a12*y*z) 
+				   + 2*(b0*x + b1*y + b2*z) + c;
+		return w>0 and r>0 ? r/w : 0.0;
+	}
+};
+
+const float border_weight = 10.f; // how much borders and seams resist moving away
+
+enum class Kind : char { 
+	Manifold, // inside a surface, can collapse to any neighbour
+	Border,   // on an open border, only collapses along it
+	Seam,     // on a seam (two vertexes, same position), collapses along it with its sibling
+	Locked    // anything else (corners, non-manifold), does not move
+};
+
+inline std::uint64_t edgeKey(int a, int b) { 
+	return (std::uint64_t(std::uint32_t(a))<<32)|std::uint32_t(b); 
+}
+
+}
+
+std::vector<int> simplify(const std::vector<glm::vec3> &positions, const std::vector<int> &triangles,
+						  std::size_t target_index_count, float max_error, float *result_error) 
+{
+	if (result_error) *result_error = 0.f;
+	std::vector<int> idx = triangles;
+	int nverts = positions.size();
+	if (idx.size()<=target_index_count or nverts==0) return idx;
+	
+	glm::vec3 pmin, pmax;
+	std::tie(pmin,pmax) = getBoundingBox(positions);
+	float extent = glm::length(pmax-pmin);
+	if (extent==0.f) return idx;
+	
+	// group vertexes with the same position: rep is the first one of each
+	// group, and next_wedge links the vertexes of a group in a circular list
+	std::vector<int> rep(nverts), next_wedge(nverts);
+	{
+		std::vector<int> order(nverts);
+		std::iota(order.begin(),order.end(),0);
+		auto less = [&positions](int a, int b) {
+			const glm::vec3 &pa = positions[a], &pb = positions[b];
+			if (pa.x!=pb.x) return pa.x<pb.x;
+			if (pa.y!=pb.y) return pa.y<pb.y;
+			if (pa.z!=pb.z) return pa.z<pb.z;
+			return a<b;
+		};
+		std::sort(order.begin(),order.end(),less);
+		for(int i=0,j;i<nverts;i=j) {
+			for(j=i+1;j<nverts and positions[order[j]]==positions[order[i]];++j);
+			for(int k=i;k<j;++k) {
+				rep[order[k]] = order[i];
+				next_wedge[order[k]] = order[k+1<j?k+1:i];
+			}
+		}
+	}
+	
+	// directed edges of the current mesh, sorted for searching
+	std::vector<std::uint64_t> edges;
+	auto hasEdge = [&edges](int a, int b) { return std::binary_search(edges.begin(),edges.end(),edgeKey(a,b)); };
+	auto isOpen = [&](int a, int b) { return hasEdge(a,b)!=hasEdge(b,a); }; // used in just one direction
+	auto buildEdges = [&]() {
+		edges.resize(idx.size());
+		for(std::size_t t=0;t<idx.size();t+=3) 
+			for(int k=0;k<3;++k) 
+				edges[t+k] = edgeKey(idx[t+k],idx[t+(k+1)%3]);
+		std::sort(edges.begin(),edges.end());
+	};
+	
+	// initial quadrics (by group): triangle planes weighted by area, and 
+	// planes perpendicular to the triangles along borders and seams
+	std::vector<Quadric> quadrics(nverts);
+	buildEdges();
+	for(std::size_t t=0;t<idx.size();t+=3) {
+		const int *tv = &idx[t];
+		glm::vec3 n = glm::cross(positions[tv[1]]-positions[tv[0]],positions[tv[2]]-positions[tv[0]]);
+		float len = glm::length(n);
+		if (len==0.f) continue;
+		n /= len;
+		for(int k=0;k<3;++k) 
+			quadrics[rep[tv[k]]].addPlane(n,positions[tv[0]],len*0.5f);
+		for(int k=0;k<3;++k) {
+			int a = tv[k], b = tv[(k+1)%3];
+			if (hasEdge(b,a)) continue;
+			glm::vec3 e = positions[b]-positions[a];
+			glm::vec3 m = glm::cross(e,n);
+			float mlen = glm::length(m);
+			if (mlen==0.f) continue;
+			float weight = glm::dot(e,e)*border_weight;
+			quadrics[rep[a]].addPlane(m/mlen,positions[a],weight);
+			quadrics[rep[b]].addPlane(m/mlen,positions[a],weight);
+		}
+	}
+	
+	VertexAdjacency adjacency;
+	std::vector<int> remap(nverts), open_count(nverts);
+	std::vector<Kind> kind(nverts);
+	std::vector<char> touched(nverts);
+	struct Collapse { int u, v; float error; };
+	std::vector<Collapse> best(nverts);
+	std::vector<Collapse> collapses;
+	float max_applied = 0.f;
+	
+	// the sibling of u in a seam, -1 if none
+	auto sibling = [&](int u) {
+		for(int x=next_wedge[u];x!=u;x=next_wedge[x]) 
+			if (adjacency.degree(x)>0) return x;
+		return -1;
+	};
+	// the vertex at the same position as v connected by a seam edge to u2
+	auto seamTarget = [&](int u2, int v) {
+		int x = v;
+		do {
+			if (adjacency.degree(x)>0 and isOpen(u2,x)) return x;
+			x = next_wedge[x];
+		} while (x!=v);
+		return -1;
+	};
+	auto canCollapse = [&](int u, int v) {
+		if (rep[u]==rep[v]) return false;
+		switch(kind[u]) {
+		case Kind::Manifold: return true;
+		case Kind::Border: return isOpen(u,v);
+		case Kind::Seam: {
+			if (not isOpen(u,v)) return false;
+			int u2 = sibling(u);
+			return u2!=-1 and seamTarget(u2,v)!=-1;
+		}
+		default: return false;
+		}
+	};
+	// true if moving u onto v flips (or collapses to a line) some triangle 
+	// that is not removed by the collapse
+	auto flips = [&](int u, int v) {
+		for(int t : adjacency.trianglesAround(u)) {
+			const int *tv = &idx[t*3];
+			if (tv[0]==v or tv[1]==v or tv[2]==v) continue;
+			glm::vec3 p[3], q[3];
+			for(int k=0;k<3;++k) { p[k] = positions[tv[k]]; q[k] = tv[k]==u ? positions[v] : p[k]; }
+			glm::vec3 n0 = glm::cross(p[1]-p[0],p[2]-p[0]), n1 = glm::cross(q[1]-q[0],q[2]-q[0]);
+			if (glm::dot(n0,n1)<=0.f) return true;
+		}
+		return false;
+	};
+	
+	while (idx.size()>target_index_count) {
+		int ntris = idx.size()/3;
+		
+		adjacency = VertexAdjacency(idx,nverts);
+		
+		// classify vertexes
+		std::fill(open_count.begin(),open_count.end(),0);
+		for(std::size_t t=0;t<idx.size();t+=3) {
+			for(int k=0;k<3;++k) {
+				int a = idx[t+k], b = idx[t+(k+1)%3];
+				if (not hasEdge(b,a)) { ++open_count[a]; ++open_count[b]; }
+			}
+		}
+		for(int v=0;v<nverts;++v) {
+			int wedges = 1, u2 = -1;
+			for(int x=next_wedge[v];x!=v;x=next_wedge[x]) 
+				if (adjacency.degree(x)>0) { ++wedges; u2 = x; }
+			if (wedges==1) 
+				kind[v] = open_count[v]==0 ? Kind::Manifold : (open_count[v]==2 ? Kind::Border : Kind::Locked);
+			else if (wedges==2 and open_count[v]==2 and open_count[u2]==2) 
+				kind[v] = Kind::Seam;
+			else
+				kind[v] = Kind::Locked;
+		}
+		
+		// best collapse for each vertex
+		for(int v=0;v<nverts;++v) best[v] = {v,-1,0.f};
+		for(std::size_t t=0;t<idx.size();t+=3) {
+			for(int k=0;k<3;++k) {
+				int a = idx[t+k], b = idx[t+(k+1)%3];
+				for(int s=0;s<2;++s,std::swap(a,b)) {
+					if (not canCollapse(a,b)) continue;
+					Quadric q = quadrics[rep[a]]; q += quadrics[rep[b]];
+					float error = std::sqrt(q.eval(positions[b]))/extent;
+					if (best[a].v==-1 or error<best[a].error) best[a] = {a,b,error};
+				}
+			}
+		}
+		collapses.clear();
+		for(const Collapse &c : best) 
+			if (c.v!=-1 and c.error<=max_error) collapses.push_back(c);
+		std::sort(collapses.begin(),collapses.end(),[](const Collapse &a, const Collapse &b) { return a.error<b.error; });
+		
+		// apply as many as possible, without touching the same area twice
+		std::iota(remap.begin(),remap.end(),0);
+		std::fill(touched.begin(),touched.end(),0);
+		int removed = 0;
+		for(const Collapse &c : collapses) {
+			if ((ntris-removed)*3<=int(target_index_count)) break;
+			int u = c.u, v = c.v, u2 = -1, v2 = -1;
+			if (kind[u]==Kind::Seam) {
+				u2 = sibling(u); v2 = seamTarget(u2,v);
+				if (v2==-1 or touched[u2] or touched[v2]) continue;
+			}
+			if (touched[u] or touched[v]) continue;
+			if (flips(u,v) or (u2!=-1 and flips(u2,v2))) continue;
+			
+			remap[u] = v; 
+			if (u2!=-1) remap[u2] = v2;
+			quadrics[rep[v]] += quadrics[rep[u]];
+			max_applied = std::max(max_applied,c.error);
+			for(int w : {u,u2}) {
+				if (w==-1) continue;
+				int target = w==u ? v : v2;
+				for(int t : adjacency.trianglesAround(w)) {
+					const int *tv = &idx[t*3];
+					if (tv[0]==target or tv[1]==target or tv[2]==target) ++removed;
+					touched[tv[0]] = touched[tv[1]] = touched[tv[2]] = 1;
+				}
+			}
+			touched[v] = 1; if (v2!=-1) touched[v2] = 1;
+		}
+		if (removed==0) break;
+		
+		std::vector<int> next; next.reserve(idx.size()-removed*3);
+		for(std::size_t t=0;t<idx.size();t+=3) {
+			int a = remap[idx[t]], b = remap[idx[t+1]], c = remap[idx[t+2]];
+			if (a!=b and b!=c and a!=c) { next.push_back(a); next.push_back(b); next.push_back(c); }
+		}
+		idx.swap(next);
+		buildEdges();
+	}
+	
+	if (result_error) *result_error = max_applied;
+	return idx;
+}
+
+std::vector<LodLevel> generateLods(Geometry &g, int max_levels, float max_error) {
+	std::vector<LodLevel> lods;
+	if (g.triangles.empty()) return lods;
+	lods.resize(1);
+	lods[0].count = g.triangles.size();
+	std::vector<int> current = g.triangles;
+	float error = 0.f;
+	while (int(lods.size())<max_levels) {
+		float level_error = 0.f;
+		std::vector<int> next = simplify(g.positions,current,current.size()/2,max_error-error,&level_error);
+		if (next.empty() or next.size()>current.size()*3/4) break; // can't be simplified much more
+		error += level_error; // (errors are relative to the previous level)
+		LodLevel lod;
+		lod.first = g.triangles.size(); lod.count = next.size(); lod.error = error;
+		g.triangles.insert(g.triangles.end(),next.begin(),next.end());
+		lods.push_back(lod);
+		current.swap(next);
+	}
+	g.trianglesChanged();
+	return lods;
+}
+
@@ -1,5 +1,16 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include "Misc.hpp"
 #include "Debug.hpp"
+#ifdef _WIN32
+#	include <process.h>
+#	define getpid _getpid
+#else
+#	include <unistd.h>
+#endif
 
 std::string extractFolder(const std::string &filename) {
 	int i = static_cast<int>(filename.size())-1;
@@ -32,3 +43,27 @@ std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v) {
 	}
 	return {pmin,pmax};
 }
+
+float projectedSize(float size, float distance, float fovy, int viewport_height) {
+	if (distance<=0.f) return std::numeric_limits<float>::max();
+	return size/(2.f*distance*std::tan(fovy/2.f))*viewport_height;
+}
+
+std::string uniqueTempPath(const std::string &path) {
+	static std::atomic<unsigned> counter(0);
+	return path+"."+std::to_string(getpid())+"."+std::to_string(counter++)+".tmp";
+}
+
+bool replaceFile(const std::string &path, const std::function<bool(std::ostream&)> &write) {
+	std::string tmp_path = uniqueTempPath(path);
+	{
+		std::ofstream f(tmp_path,std::ios::binary|std::ios::trunc);
+		if (not f.is_open()) return false; // read-only folder, just don't write it
+		bool ok = write(f);
+		f.close();
+		if (not ok or f.fail()) { std::remove(tmp_path.c_str()); return false; }
+	}
+	std::remove(path.c_str()); // rename fails on windows if it already exists
+	if (std::rename(tmp_path.c_str(),path.c_str())!=0) { std::remove(tmp_path.c_str()); return false; }
+	return true;
+}
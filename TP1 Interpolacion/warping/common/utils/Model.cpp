@@ -5,32 +5,255 @@
 #include "Debug.hpp"
 #include "ObjMesh.hpp"
 #include "Misc.hpp"
+#include "ThreadPool.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "AssetCache.hpp"
 
-Model Model::loadSingle(const std::string &name, int flags) {
-	ObjMesh obj = readObj("models/"+name+".obj");
-	if (!(flags&fDontFit)) centerAndResize(obj.positions);
+namespace {
+	
+// only the flags that change the generated geometry are part of the cache key
+std::uint32_t cacheKey(int flags) {
+	return flags&(Model::fDontFit|Model::fRegenerateNormals|Model::fNoTextures|Model::fOptimize|Model::fLods);
+}
+
+// same part with the same geometry flags means the same vertexes, no
+// matter if it came from the cache, the whole .obj or just that part
+std::string partKey(const std::string &obj_path, int ipart, int flags) {
+	return obj_path+"#"+std::to_string(ipart)+"#"+std::to_string(cacheKey(flags));
+}
+
+// last steps for every part, after toGeometry
+std::vector<LodLevel> processGeometry(Geometry &geometry, int flags) {
+	if (flags&Model::fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
+	std::vector<LodLevel> lods;
+	if (flags&Model::fLods) {
+		lods = generateLods(geometry);
+		cg_info("  levels of detail: "+std::to_string(lods.size())+", coarsest: "
+				+std::to_string(lods.empty() ? 0 : lods.back().count/3)+" triangles");
+	}
+	if (flags&Model::fOptimize) {
+#ifndef NDEBUG
+		VertexCacheStats before = analyzeVertexCache(geometry);
+#endif
+		if (lods.empty()) optimizeVertexCache(geometry);
+		for(const LodLevel &lod : lods) { // each level by its own
+			auto begin = geometry.triangles.begin()+lod.first;
+			std::vector<int> range(begin,begin+lod.count);
+			optimizeVertexCache(range,geometry.positions.size());
+			std::copy(range.begin(),range.end(),begin);
+		}
+		optimizeVertexFetch(geometry);
+#ifndef NDEBUG
+		VertexCacheStats after = analyzeVertexCache(geometry);
+		cg_info( "  vertex cache: ACMR " + std::to_string(before.acmr) + " -> " + std::to_string(after.acmr) 
+				 + ", ATVR " + std::to_string(before.atvr) + " -> " + std::to_string(after.atvr) );
+#endif
+	}
+	return lods;
+}
+
+// reads a single part, but fits it as if the whole model was read
+ModelData readPart(const ObjIndex &index, int ipart, int flags, ObjMesh &obj) {
+	obj = index.readPart(ipart);
+	if (flags&Model::fNoTextures) obj.parts[0].material.texture.clear();
+	if (!(flags&Model::fDontFit)) {
+		if (static_cast<int>(obj.positions.size())==index.positionsCount()) 
+			centerAndResize(obj.positions);
+		else
+			centerAndResize(obj.positions,index.boundingBox());
+	}
 	Geometry geometry = toGeometry(obj,0);
-	if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-	return Model(std::move(geometry), obj.parts[0].material, flags&fKeepGeometry);
+	std::vector<LodLevel> lods = processGeometry(geometry,flags);
+	return { std::move(geometry), obj.parts[0].material, flags, std::move(lods), partKey(index.fileName(),ipart,flags) };
+}
+
+std::vector<std::string> cacheSources(const std::string &obj_path, const ObjMesh &obj) {
+	std::vector<std::string> sources = { obj_path };
+	sources.insert(sources.end(),obj.material_libs.begin(),obj.material_libs.end());
+	return sources;
+}
+
+// loadSingle without the cache lookup (but saving the cache)
+ModelData parseSingle(const std::string &name, int flags) {
+	std::string obj_path = "models/"+name+".obj";
+	ObjIndex index(obj_path);
+	ObjMesh obj;
+	ModelData data = readPart(index,0,flags,obj);
+	if (!(flags&Model::fNoCache)) {
+		MeshCacheWriter writer(meshCachePath(obj_path,cacheKey(flags)),cacheKey(flags),
+							   cacheSources(obj_path,obj),1,index.partsCount());
+		writer.addPart(data.geometry,data.material,data.lods);
+		writer.finish();
+	}
+	return data;
+}
+	
+}
+
+Model Model::loadSingle(const std::string &name, int flags) {
+	flags &= ~fTextureArrays;
+	if (!(flags&fNoCache)) { // upload directly from the mapped cache
+		MeshCache cache(meshCachePath("models/"+name+".obj",cacheKey(flags)),cacheKey(flags));
+		if (cache.isOk()) return Model(cache.parts()[0], flags, partKey("models/"+name+".obj",0,flags));
+	}
+	return Model(parseSingle(name,flags));
+}
+
+ModelData Model::loadSingleData(const std::string &name, int flags) {
+	flags &= ~fTextureArrays;
+	if (!(flags&fNoCache)) {
+		MeshCache cache(meshCachePath("models/"+name+".obj",cacheKey(flags)),cacheKey(flags));
+		if (cache.isOk()) {
+			const MeshCache::Part &part = cache.parts()[0];
+			return {part.toGeometry(), part.material, flags, part.lods, partKey("models/"+name+".obj",0,flags)};
+		}
+	}
+	return parseSingle(name,flags);
+}
+
+std::future<ModelData> Model::loadSingleAsync(const std::string &name, int flags) {
+	return ThreadPool::shared().submit([name,flags]() { return loadSingleData(name,flags); });
+}
+
+Model Model::loadPart(const ObjIndex &index, const std::string &part_name, int flags) {
+	int ipart = index.findPart(part_name);
+	cg_assert(ipart!=-1,"Part name not found");
+	ObjMesh obj;
+	return Model(readPart(index,ipart,flags&~fTextureArrays,obj));
+}
+
+Model Model::loadPart(const std::string &name, const std::string &part_name, int flags) {
+	return loadPart(ObjIndex("models/"+name+".obj"),part_name,flags);
 }
 
 std::vector<Model> Model::load(const std::string &name, int flags) {
-	auto obj = readObj("models/"+name+".obj");
+	std::string obj_path = "models/"+name+".obj";
+	std::string cache_path = meshCachePath(obj_path,cacheKey(flags));
+	if (!(flags&fNoCache)) {
+		MeshCache cache(cache_path,cacheKey(flags));
+		if (cache.isOk() and cache.isComplete()) {
+			std::vector<Model> vret; vret.reserve(cache.parts().size());
+			for (std::size_t i=0; i<cache.parts().size(); ++i)
+				vret.emplace_back(cache.parts()[i], flags, partKey(obj_path,i,flags));
+			if (flags&fTextureArrays) packTextures(vret,flags);
+			return vret;
+		}
+	}
+	
+	auto obj = readObj(obj_path);
 	if (!(flags&fDontFit)) centerAndResize(obj.positions);
 	
-	std::vector<Model> vret; vret.reserve(obj.parts.size());
+	std::vector<ModelData> datas; datas.reserve(obj.parts.size());
 	for (auto &part : obj.parts) {
+		if (flags&fNoTextures) part.material.texture.clear();
 		Geometry geometry = toGeometry(obj,part);
-		if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-		vret.emplace_back(std::move(geometry), part.material, flags&fKeepGeometry);
+		std::vector<LodLevel> lods = processGeometry(geometry,flags);
+		datas.push_back({std::move(geometry), part.material, flags, std::move(lods), partKey(obj_path,datas.size(),flags)});
+	}
+	
+	if (!(flags&fNoCache)) {
+		MeshCacheWriter writer(cache_path,cacheKey(flags),cacheSources(obj_path,obj),
+							   obj.parts.size(),obj.parts.size());
+		for (const ModelData &data : datas) 
+			writer.addPart(data.geometry,data.material,data.lods);
+		writer.finish();
 	}
+	
+	std::vector<Model> vret; vret.reserve(obj.parts.size());
+	for (ModelData &data : datas)
+		vret.emplace_back(std::move(data));
+	if (flags&fTextureArrays) packTextures(vret,flags);
 	return vret;
 }
 
+void Model::setLod(int level) {
+	if (lods.empty()) return;
+	lod = std::min(std::max(level,0),int(lods.size())-1);
+}
+
+std::shared_ptr<Texture> Model::loadTexture(const std::string &fname, int flags) {
+	if (fname.empty() or flags&fTextureArrays) return nullptr;
+	return AssetCache::shared().texture(fname,textureFlags(flags));
+}
+
+void Model::packTextures(std::vector<Model> &models, int flags) {
+	// distinct images, in the order they are first used
+	std::vector<std::string> fnames;
+	for(const Model &m : models)
+		if (not m.material.texture.empty() and std::find(fnames.begin(),fnames.end(),m.material.texture)==fnames.end())
+			fnames.push_back(m.material.texture);
+	if (fnames.empty()) return;
+	
+	// read them (usually just mapping their caches) to know their sizes and formats
+	bool use_cache = not (flags&fNoCache), compress = (flags&fCompressTextures) and GLAD_GL_EXT_texture_compression_s3tc;
+	std::vector<TextureImage> images(fnames.size());
+	ThreadPool::shared().parallelFor(static_cast<int>(fnames.size()),[&](int i) {
+		images[i] = loadTextureImage(fnames[i],use_cache,compress);
+	});
+	
+	// one array per group of compatible images; the key is the list of images
+	std::vector<std::vector<int>> groups;
+	for(int i=0; i<static_cast<int>(images.size()); ++i) {
+		cg_assert(images[i].isOk(),"Could not load texture");
+		if (not images[i].isOk()) continue;
+		auto g = std::find_if(groups.begin(),groups.end(),[&](const std::vector<int> &g) { 
+			return TextureArray::compatible(images[g[0]],images[i]); 
+		});
+		if (g==groups.end()) groups.push_back({i});
+		else g->push_back(i);
+	}
+	std::vector<std::shared_ptr<TextureArray>> arrays(fnames.size());
+	std::vector<int> layers(fnames.size(),0);
+	for(const std::vector<int> &g : groups) {
+		std::string key = std::to_string(textureFlags(flags)&~Texture::fAsync);
+		for(int i : g) key += "|"+fnames[i];
+		auto array = AssetCache::shared().textureArray(key,[&]() {
+			std::vector<TextureImage> group_images;
+			for(int i : g) group_images.push_back(images[i]);
+			return TextureArray(group_images);
+		});
+		for(std::size_t j=0; j<g.size(); ++j) {
+			arrays[g[j]] = array;
+			layers[g[j]] = static_cast<int>(j);
+		}
+	}
+	
+	for(Model &m : models) {
+		if (m.material.texture.empty()) continue;
+		int i = static_cast<int>(std::find(fnames.begin(),fnames.end(),m.material.texture)-fnames.begin());
+		if (not arrays[i]) continue;
+		m.texture = nullptr;
+		m.texture_array = arrays[i];
+		m.texture_layer = layers[i];
+		MaterialBlock block(m.material);
+		block.texture_layer = static_cast<float>(m.texture_layer);
+		m.material_buffer.update(block);
+	}
+}
+
+std::shared_ptr<GeometryRenderer> Model::shareBuffers(const std::string &key, int flags, 
+                                                      const std::function<GeometryRenderer()> &create) 
+{
+	if (key.empty() or flags&(fDynamic|fKeepGeometry)) return std::make_shared<GeometryRenderer>(create());
+	return AssetCache::shared().geometry(key+"#"+std::to_string(bufferFormat(flags)),create);
+}
+
+int Model::selectLod(float screen_size, float max_pixel_error) {
+	int level = 0; // errors grow with the level, so take the last one that fits
+	for (int i=1;i<int(lods.size());++i) 
+		if (lods[i].error*screen_size<=max_pixel_error) level = i;
+	setLod(level);
+	return level;
+}
+
 void centerAndResize(std::vector<glm::vec3> &v) {
-	// get global bb
+	centerAndResize(v,getBoundingBox(v));
+}
+
+void centerAndResize(std::vector<glm::vec3> &v, const std::pair<glm::vec3,glm::vec3> &bb) {
 	glm::vec3 pmin, pmax;
-	std::tie(pmin,pmax) = getBoundingBox(v);
+	std::tie(pmin,pmax) = bb;
 	
 	// center on 0,0,0
 	glm::vec3 center = (pmax+pmin)/2.f;
@@ -0,0 +1,114 @@
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "ProgramCache.hpp"
+#include "MappedFile.hpp"
+#include "Misc.hpp"
+#include "Debug.hpp"
+
+// File layout (native endianness):
+//   header: magic "CGPB", version, key (u64), binary format, binary length
+//   binary: the bytes from glGetProgramBinary
+
+namespace {
+
+const char cache_magic[4] = {'C','G','P','B'};
+const std::uint32_t cache_version = 1;
+
+struct Header {
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t key;
+	std::uint32_t format, length;
+};
+
+// FNV-1a
+std::uint64_t hashBytes(std::uint64_t h, const char *p, std::size_t n) {
+	for(std::size_t i=0;i<n;++i) { h ^= static_cast<unsigned char>(p[i]); h *= 1099511628211ull; }
+	return h;
+}
+
+std::uint64_t hashString(std::uint64_t h, const char *s) {
+	if (not s) s = "";
+	return hashBytes(h,s,std::strlen(s)+1); // the '\0' separates consecutive strings
+}
+
+std::string removeExtension(const std::string &fname) {
+	auto p = fname.find_last_of("./\\");
+	return (p!=std::string::npos and fname[p]=='.') ? fname.substr(0,p) : fname;
+}
+
+}
+
+bool programBinarySupported() {
+	static int supported = -1; // the answer won't change, but every Shader asks
+	if (supported==-1) {
+		GLint formats = 0;
+		if (GLAD_GL_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&formats);
+		supported = formats>0 ? 1 : 0;
+	}
+	return supported==1;
+}
+
+std::uint64_t programCacheKey(const std::string &vertex_source, const std::string &fragment_source) {
+	std::uint64_t h = 14695981039346656037ull;
+	h = hashString(h,vertex_source.c_str());
+	h = hashString(h,fragment_source.c_str());
+	for(GLenum name : {GL_VENDOR,GL_RENDERER,GL_VERSION})
+		h = hashString(h,reinterpret_cast<const char*>(glGetString(name)));
+	return h;
+}
+
+std::string programCachePath(const std::string &vertex_fname, const std::string &fragment_fname) {
+	std::string vbase = removeExtension(vertex_fname), fbase = removeExtension(fragment_fname);
+	if (vbase==fbase) return vbase+".pcache"; // phong.vert+phong.frag -> phong.pcache
+	auto p = fbase.find_last_of("/\\");
+	return vbase+"-"+(p==std::string::npos?fbase:fbase.substr(p+1))+".pcache";
+}
+
+bool loadProgramBinary(GLuint program, const std::string &cache_path, std::uint64_t key) {
+	if (not programBinarySupported()) return false;
+	MappedFile file(cache_path);
+	if (not file.isOk() or file.size()<sizeof(Header)) return false;
+
+	Header h; std::memcpy(&h,file.begin(),sizeof(Header));
+	if (std::memcmp(h.magic,cache_magic,4)!=0 or h.version!=cache_version or h.key!=key) return false;
+	if (file.size()-sizeof(Header)!=h.length) return false;
+
+	glProgramBinary(program,h.format,file.begin()+sizeof(Header),h.length);
+	GLint result = GL_FALSE;
+	glGetProgramiv(program,GL_LINK_STATUS,&result);
+	if (result!=GL_TRUE) {
+		cg_info("Program binary rejected: " + cache_path);
+		return false;
+	}
+	return true;
+}
+
+void prepareProgramBinary(GLuint program) {
+	if (programBinarySupported())
+		glProgramParameteri(program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+}
+
+bool saveProgramBinary(GLuint program, const std::string &cache_path, std::uint64_t key) {
+	if (not programBinarySupported()) return false;
+	GLint length = 0;
+	glGetProgramiv(program,GL_PROGRAM_BINARY_LENGTH,&length);
+	if (length<=0) return false;
+
+	std::vector<char> binary(length);
+	GLenum format = 0; GLsizei written = 0;
+	glGetProgramBinary(program,length,&written,&format,binary.data());
+	if (written<=0) return false;
+
+	Header h; std::memcpy(h.magic,cache_magic,4);
+	h.version = cache_version; h.key = key;
+	h.format = format; h.length = static_cast<std::uint32_t>(written);
+
+	return replaceFile(cache_path,[&](std::ostream &f) {
+		f.write(reinterpret_cast<const char*>(&h),sizeof(Header));
+		f.write(binary.data(),written);
+		return true;
+	});
+}
+
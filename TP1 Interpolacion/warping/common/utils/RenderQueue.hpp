@@ -0,0 +1,73 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include "Shaders.hpp"
+#include "Texture.hpp"
+#include "Material.hpp"
+#include "Geometry.hpp"
+#include "Model.hpp"
+#include "UniformBlocks.hpp"
+
+// Collects the draws of a frame and issues them sorted by program, texture,
+// material and geometry, sending only the state that differs from the 
+// previous draw (instead of use+setMatrixes+setLight+setMaterial+bind+
+// setBuffers for every part). Opaque items are drawn first (sorted), then
+// transparent ones (opacity<1) in submission order, so blending still works.
+// Shaders, textures, materials and buffers are referenced, not copied, so 
+// they must live until flush().
+class RenderQueue {
+public:
+	// per-frame counters (of the last flush)
+	struct Stats {
+		int items = 0;
+		int programs = 0, textures = 0, materials = 0, buffers = 0; // state changes issued
+		int saved = 0; // state changes skipped, compared to setting everything for every item
+	};
+	
+	// camera and light are the same for every item; they are sent once per program
+	void setCamera(const glm::mat4 &view, const glm::mat4 &projection);
+	void setLight(const glm::vec4 &position, const glm::vec3 &color, float ambient_strength);
+	
+	// texture can be null (or not initialized) for untextured items; 
+	// material_buffer (if any) is bound for programs with a Material block
+	void add(Shader &shader, const GeometryRenderer &buffers, const Material &material, 
+			 const Texture *texture, const glm::mat4 &model_matrix, 
+			 const UniformBuffer *material_buffer = nullptr);
+	// (with its texture_array if it has one)
+	void add(Shader &shader, const Model &model, const glm::mat4 &model_matrix);
+	
+	// sorts and draws all the items, and empties the queue
+	void flush();
+	
+	const Stats &stats() const { return last_stats; }
+	int size() const { return items.size(); }
+	
+private:
+	struct Item {
+		Shader *shader;
+		const GeometryRenderer *buffers;
+		int first, count; // range of indexes to draw
+		const Material *material;
+		const UniformBuffer *material_buffer; // null if none
+		const Texture *texture; // null if untextured
+		const TextureArray *texture_array; // (instead of texture)
+		GLuint texture_id; // 0 if untextured
+		int texture_layer; // in texture_array (its material_buffer must be bound again if it changes)
+		int material_id; // same id for materials with the same values
+		glm::mat4 model_matrix;
+		bool transparent;
+	};
+	int materialId(const Material &material);
+	std::vector<Item> items;
+	std::vector<Item*> order;
+	std::vector<const Material*> materials; // distinct materials of this frame
+	glm::mat4 view_matrix = glm::mat4(1.f), projection_matrix = glm::mat4(1.f);
+	glm::vec4 light_position = {0.f,0.f,0.f,1.f};
+	glm::vec3 light_color = {1.f,1.f,1.f};
+	float ambient_strength = 0.f;
+	Stats last_stats;
+};
+
+#endif
+
@@ -1,13 +1,28 @@
 #ifndef SHADERS_H
 #define SHADERS_H
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/matrix_float3x3.hpp>
 #include "Material.hpp"
 #include "Geometry.hpp"
 
 class Shader {
 public:
+	// pre-resolved handle of an active uniform (see getUniform); the type is
+	// the one of the values that setUniform accepts for it
+	template<typename T> class Uniform {
+	public:
+		Uniform() = default;
+		bool isValid() const { return slot!=-1; }
+	private:
+		friend class Shader;
+		explicit Uniform(int s) : slot(s) {}
+		int slot = -1;
+	};
+	
 	Shader() = default;
 	Shader(Shader &&other);
 	Shader &operator=(Shader &&other);
@@ -18,23 +33,90 @@ public:
 	void load(const std::string &fname);
 	void load(const std::string &vertex_fname, const std::string &fragment_fname);
 	
+	// like load, but only submits the shaders to the driver, without waiting
+	// for the results; with GL_KHR_parallel_shader_compile, all the programs
+	// loaded this way are compiled and linked at the same time by the driver's
+	// threads. Errors are checked (and the program inspected) the first time 
+	// it is used (use, setUniform, getUniform, setBuffers, ...)
+	void loadDeferred(const std::string &fname);
+	void loadDeferred(const std::string &vertex_fname, const std::string &fragment_fname);
+	// false while the driver is still building it (using it then waits until
+	// it is done); always true without GL_KHR_parallel_shader_compile
+	bool isReady() const;
+	
 	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true);
-	void setBuffers(const GeometryRenderer &geo);
+	// with instanced, the instanceMatrix attribute takes the matrixes from
+	// geo.setInstanceMatrixes (for geo.drawInstanced), otherwise it is the identity
+	void setBuffers(const GeometryRenderer &geo, bool instanced=false);
+	// instanced, but with matrixes from another buffer (e.g. a Model's, as 
+	// its GeometryRenderer can be shared); draw with geo.drawInstanced(instances.count(),...)
+	void setBuffers(const GeometryRenderer &geo, const InstanceBuffer &instances);
 	void setMaterial(const Material &mat);
 	void setMatrixes(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection);
+	// only modelMatrix and normalMatrix (the inverse transpose of view*model, 
+	// computed here once per object instead of once per vertex), for programs 
+	// that take view and projection from the Camera block (see UniformBlocks.hpp)
+	void setModelMatrix(const glm::mat4 &model, const glm::mat4 &view);
 	void setLight(const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength);
 	
+	// all active uniforms and attributes are looked up once, after linking, so
+	// these don't query the driver; an invalid handle means the program does 
+	// not use that uniform
+	template<typename T> Uniform<T> getUniform(const char *name) { finishLoad(); return Uniform<T>(findUniform(name)); }
+	GLint getAttribLocation(const char *name); // -1 if not used
+	
+	// values are cached, so uploading the same value again is skipped (don't
+	// mix with direct glUniform* calls on the same program)
+	bool setUniform(Uniform<int> u, int v);
+	bool setUniform(Uniform<float> u, float v);
+	bool setUniform(Uniform<glm::vec2> u, const glm::vec2 &v);
+	bool setUniform(Uniform<glm::vec3> u, const glm::vec3 &v);
+	bool setUniform(Uniform<glm::vec4> u, const glm::vec4 &v);
+	bool setUniform(Uniform<glm::mat3> u, const glm::mat3 &v);
+	bool setUniform(Uniform<glm::mat4> u, const glm::mat4 &v);
+	bool setUniform(const char *name, int v);
 	bool setUniform(const char *name, float v);
+	bool setUniform(const char *name, const glm::vec2 &v);
 	bool setUniform(const char *name, const glm::vec3 &v);
 	bool setUniform(const char *name, const glm::vec4 &v);
+	bool setUniform(const char *name, const glm::mat3 &v);
 	bool setUniform(const char *name, const glm::mat4 &v);
 	
 	GLuint getProgramId() const { return program_id; }
+	int skippedUploads() const { return skipped_uploads; } // redundant glUniform* calls avoided so far
 	
-	void use() const;
+	void use();
 	~Shader();
 private:
 	Shader &operator=(const Shader &) = default;
+	void finishLoad(); // checks and inspects a program from loadDeferred (if any)
+	void bindBuffers(const GeometryRenderer &geo, GLuint instances_vbo); // (0 if not instanced)
+	void reflect();
+	int findUniform(const char *name) const;
+	bool isUploaded(int slot, const void *value, int bytes);
+	struct UniformSlot {
+		std::string name; // arrays have one slot per element: name (same as name[0]), name[1], ...
+		GLint location = -1;
+		int bytes = 0; // size of the last uploaded value (0 if none yet)
+		alignas(float) unsigned char value[sizeof(glm::mat4)];
+	};
+	std::vector<UniformSlot> uniforms; // sorted by name
+	std::vector<std::pair<std::string,GLint>> attribs; // sorted by name
+	struct { // handles for the names used by setMatrixes, setLight, setMaterial and setBuffers
+		Uniform<glm::mat4> model, view, projection; Uniform<glm::mat3> normal_matrix;
+		Uniform<glm::vec4> light_position; Uniform<glm::vec3> light_color; Uniform<float> ambient_strength;
+		Uniform<glm::vec3> diffuse, specular, ambient, emission; Uniform<float> opacity, shininess;
+		Uniform<glm::vec3> position_scale, position_offset; Uniform<glm::vec2> tex_coords_scale, tex_coords_offset;
+		Uniform<int> octahedral_normals;
+		GLint position = -1, normal = -1, tex_coords = -1, instance_matrix = -1; // attributes
+	} common;
+	struct PendingLoad { // what finishLoad needs from loadDeferred
+		std::string vertex_fname, fragment_fname, cache_path;
+		std::uint64_t cache_key = 0;
+		GLuint vertex_id = 0, fragment_id = 0; // 0 if loaded from the cache
+		bool loading = false;
+	} pending;
+	int skipped_uploads = 0;
 	GLuint program_id = 0;
 };
 
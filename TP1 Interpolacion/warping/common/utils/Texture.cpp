@@ -1,31 +1,147 @@
-#include <stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include "Texture.hpp"
+#include "ThreadPool.hpp"
 #include "Debug.hpp"
 
-Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t) {
+namespace {
+
+GLenum pixelFormat(TextureFormat format) {
+	switch(format) {
+		case TextureFormat::RGB: return GL_RGB;
+		case TextureFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TextureFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		default: return GL_RGBA;
+	}
+}
+
+// number of the smallest mipmap level (the 1x1 one)
+int lastLevel(int width, int height) {
+	int levels = 0;
+	for(int s = std::max(width,height); s>1; s/=2) ++levels;
+	return levels;
+}
+
+// with pixels==nullptr it only allocates the level
+void defineLevel(TextureFormat format, int level, const TextureLevel &l, const void *pixels) {
+	if (isCompressed(format))
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, pixelFormat(format), l.width, l.height, 0, static_cast<GLsizei>(l.size), pixels);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, l.width, l.height, 0, pixelFormat(format), GL_UNSIGNED_BYTE, pixels);
+}
+
+// allocates a level of every layer of a GL_TEXTURE_2D_ARRAY
+void defineArrayLevel(TextureFormat format, int level, const TextureLevel &l, int layers) {
+	if (isCompressed(format))
+		glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, pixelFormat(format), l.width, l.height, layers, 0, static_cast<GLsizei>(l.size*layers), nullptr);
+	else
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, l.width, l.height, layers, 0, pixelFormat(format), GL_UNSIGNED_BYTE, nullptr);
+}
+
+void uploadArrayLayer(TextureFormat format, int level, int layer, const TextureLevel &l) {
+	if (isCompressed(format))
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, l.width, l.height, 1, pixelFormat(format), static_cast<GLsizei>(l.size), l.data);
+	else
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, l.width, l.height, 1, pixelFormat(format), GL_UNSIGNED_BYTE, l.data);
+}
+
+// GPU bytes of one level (uncompressed ones are uploaded as GL_RGBA)
+std::size_t levelMemorySize(const TextureImage &img, int level) {
+	const TextureLevel &l = img.levels[level];
+	return isCompressed(img.format) ? l.size : std::size_t(l.width)*l.height*4;
+}
+
+// finest level with at least screen_size texels in its largest side
+int neededLevel(const TextureImage &img, float screen_size, int tail) {
+	if (screen_size<=0.f) return tail;
+	float ratio = std::max(img.width(),img.height())/screen_size;
+	int level = ratio>1.f ? static_cast<int>(std::floor(std::log2(ratio))) : 0;
+	return std::min(level,tail);
+}
+
+}
+
+TextureImage loadTextureImage(const std::string &fname, bool use_cache, bool compress) {
+	std::string cache_path = textureCachePath(fname,compress);
+	if (use_cache) {
+		TextureImage img = readTextureCache(cache_path);
+		if (img.isOk()) return img;
+	}
+	TextureImage img = decodeTextureImage(fname);
+	if (not img.isOk() or (not use_cache and not compress)) return img; // (OpenGL will generate the mipmaps)
+	img = generateMipmaps(img);
+	if (compress) img = compressTexture(img);
+	if (use_cache) writeTextureCache(cache_path,fname,img);
+	return img;
+}
+
+Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t, int flags) {
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id); 
+	glBindTexture(GL_TEXTURE_2D, id);
 	// set the texture wrapping parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	// set texture filtering parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// load image, create texture and generate mipmaps
-	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	// The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-	unsigned char *data = stbi_load(fname.c_str(), &width, &height, &channels, 0);
-	cg_assert(data,"Could not load texture");
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, channels==3?GL_RGB:GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	stbi_image_free(data);
-	this->repeat_s = repeat_s; this->repeat_t = repeat_t;
+	this->repeat_s = repeat_s; this->repeat_t = repeat_t; this->streamed = flags&fStreamed; 
+	this->async = (flags&fAsync) and not streamed;
+	bool use_cache = not (flags&fNoCache), compress = (flags&fCompress) and GLAD_GL_EXT_texture_compression_s3tc;
+	if (streamed) { // it needs every level, so they are generated if there is no cache
+		auto load = [fname,use_cache,compress]() {
+			TextureImage img = loadTextureImage(fname,use_cache,compress);
+			return img.levels.size()==1 ? generateMipmaps(img) : img;
+		};
+		if (flags&fAsync) {
+			const unsigned char gray[4] = {128,128,128,255};
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+			TextureResidency::shared().add(id,ThreadPool::shared().submit(load));
+		} else {
+			TextureImage img = load();
+			cg_assert(img.isOk(),"Could not load texture");
+			width = img.width(); height = img.height(); channels = channelsCount(img.format);
+			TextureResidency::shared().add(id,std::move(img));
+		}
+		return;
+	}
+	if (async) {
+		const unsigned char gray[4] = {128,128,128,255};
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+		TextureUploader::shared().add(id,ThreadPool::shared().submit([fname,use_cache,compress](){
+			return loadTextureImage(fname,use_cache,compress);
+		}));
+		return;
+	}
+	// load image (or its cache), create texture and upload/generate mipmaps
+	TextureImage img = loadTextureImage(fname,use_cache,compress);
+	cg_assert(img.isOk(),"Could not load texture");
+	width = img.width(); height = img.height(); channels = channelsCount(img.format);
+	memory_size = textureMemorySize(img);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1); // rows are not padded
+	for(std::size_t i=0; i<img.levels.size(); ++i)
+		defineLevel(img.format,static_cast<int>(i),img.levels[i],img.levels[i].data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	if (img.levels.size()==1) glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 Texture::~Texture ( ) {
+	if (async) TextureUploader::shared().cancel(id);
+	if (streamed) TextureResidency::shared().remove(id);
 	glDeleteTextures(1,&id);
 }
 
+std::size_t Texture::memorySize() const {
+	if (streamed) return TextureResidency::shared().memorySize(id);
+	return async ? TextureUploader::shared().memorySize(id) : memory_size;
+}
+
+bool Texture::isLoaded() const {
+	return id!=0 and not (async and TextureUploader::shared().isLoading(id))
+		and not (streamed and TextureResidency::shared().isLoading(id));
+}
+
 void Texture::bind (int number) const {
 	cg_assert(id!=0,"texture not initialized");
 	glActiveTexture(GL_TEXTURE0+number);
@@ -45,3 +161,317 @@ Texture & Texture::operator=(Texture &&t) {
 	return *this;
 }
 
+bool TextureArray::compatible(const TextureImage &a, const TextureImage &b) {
+	return a.width()==b.width() and a.height()==b.height() and a.format==b.format
+		and a.levels.size()==b.levels.size();
+}
+
+TextureArray::TextureArray(const std::vector<TextureImage> &images, bool repeat_s, bool repeat_t) {
+	cg_assert(not images.empty() and images[0].isOk(),"Could not load texture");
+	for(const TextureImage &img : images)
+		cg_assert(compatible(img,images[0]),"Images in a TextureArray must have the same size and format");
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	this->repeat_s = repeat_s; this->repeat_t = repeat_t;
+	const TextureImage &first = images[0];
+	width = first.width(); height = first.height(); layers = static_cast<int>(images.size());
+	memory_size = textureMemorySize(first)*layers;
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1); // rows are not padded
+	for(std::size_t i=0; i<first.levels.size(); ++i) {
+		defineArrayLevel(first.format,static_cast<int>(i),first.levels[i],layers);
+		for(int layer=0; layer<layers; ++layer)
+			uploadArrayLayer(first.format,static_cast<int>(i),layer,images[layer].levels[i]);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	if (first.levels.size()==1) glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+TextureArray::TextureArray(const std::vector<std::string> &fnames, bool repeat_s, bool repeat_t, int flags) {
+	bool use_cache = not (flags&Texture::fNoCache), compress = (flags&Texture::fCompress) and GLAD_GL_EXT_texture_compression_s3tc;
+	std::vector<TextureImage> images(fnames.size());
+	ThreadPool::shared().parallelFor(static_cast<int>(fnames.size()),[&](int i) {
+		images[i] = loadTextureImage(fnames[i],use_cache,compress);
+	});
+	*this = TextureArray(images,repeat_s,repeat_t);
+}
+
+TextureArray::~TextureArray() {
+	glDeleteTextures(1,&id);
+}
+
+void TextureArray::bind(int number) const {
+	cg_assert(id!=0,"texture not initialized");
+	glActiveTexture(GL_TEXTURE0+number);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, repeat_s?GL_REPEAT:GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, repeat_t?GL_REPEAT:GL_CLAMP_TO_BORDER);
+}
+
+TextureArray::TextureArray(TextureArray &&t) {
+	*this = static_cast<const TextureArray &>(t);
+	t = static_cast<const TextureArray &>(TextureArray{});
+}
+
+TextureArray &TextureArray::operator=(TextureArray &&t) {
+	if (&t==this) return *this;
+	glDeleteTextures(1,&id);
+	*this = static_cast<const TextureArray &>(t);
+	t = static_cast<const TextureArray &>(TextureArray{});
+	return *this;
+}
+
+TextureUploader &TextureUploader::shared() {
+	static TextureUploader uploader;
+	return uploader;
+}
+
+TextureUploader::~TextureUploader() {
+	if (pbo!=0) glDeleteBuffers(1,&pbo);
+}
+
+void TextureUploader::add(GLuint texture_id, std::future<TextureImage> &&image) {
+	jobs.push_back({texture_id,std::move(image),TextureImage(),0});
+}
+
+void TextureUploader::cancel(GLuint texture_id) {
+	sizes.erase(texture_id);
+	jobs.erase(std::remove_if(jobs.begin(),jobs.end(),[&](const Job &j) { return j.texture_id==texture_id; }),jobs.end());
+}
+
+bool TextureUploader::isLoading(GLuint texture_id) const {
+	return std::any_of(jobs.begin(),jobs.end(),[&](const Job &j) { return j.texture_id==texture_id; });
+}
+
+std::size_t TextureUploader::memorySize(GLuint texture_id) const {
+	auto it = sizes.find(texture_id);
+	return it==sizes.end() ? 0 : it->second;
+}
+
+int TextureUploader::update(std::size_t budget) {
+	for(std::size_t i=0; i<jobs.size() and budget>0; ) {
+		Job &job = jobs[i];
+		if (not job.image.isOk() and
+			job.decoding.wait_for(std::chrono::seconds(0))!=std::future_status::ready)
+		{ ++i; continue; } // still decoding
+		if (upload(job,budget)) jobs.erase(jobs.begin()+i);
+		else ++i;
+	}
+	return pending();
+}
+
+void TextureUploader::finishAll() {
+	std::size_t unlimited = std::size_t(-1);
+	while (not jobs.empty())
+		if (upload(jobs.front(),unlimited)) jobs.erase(jobs.begin());
+}
+
+bool TextureUploader::upload(Job &job, std::size_t &budget) {
+	glBindTexture(GL_TEXTURE_2D, job.texture_id);
+	TextureImage &img = job.image;
+	if (not img.isOk()) { // just decoded
+		img = job.decoding.get();
+		cg_assert(img.isOk(),"Could not load texture");
+		if (not img.isOk()) return true; // (keeps the placeholder)
+		sizes[job.texture_id] = textureMemorySize(img);
+		// the placeholder moves to the last level, and only that level is
+		// used until a real one is complete
+		int last = lastLevel(img.width(),img.height());
+		const unsigned char gray[4] = {128,128,128,255};
+		glTexImage2D(GL_TEXTURE_2D, last, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, last);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, last);
+		job.level = static_cast<int>(img.levels.size())-1;
+	}
+
+	// copy as many rows as the budget allows into the PBO, and upload them
+	// from there (the driver can do that copy without blocking)
+	bool compressed = isCompressed(img.format);
+	if (pbo==0) glGenBuffers(1,&pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,pbo);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1); // rows are not padded
+	while (job.level>=0 and budget>0) {
+		const TextureLevel &l = img.levels[job.level];
+		if (job.next_row==0) defineLevel(img.format,job.level,l,nullptr);
+		int rows_count = compressed ? (l.height+3)/4 : l.height; // (a row of 4x4 blocks if compressed)
+		std::size_t row_bytes = l.size/rows_count;
+		int rows = static_cast<int>(std::min<std::size_t>(rows_count-job.next_row,std::max<std::size_t>(1,budget/row_bytes)));
+		std::size_t bytes = rows*row_bytes;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER,bytes,nullptr,GL_STREAM_DRAW); // a new buffer, so it doesn't wait for the previous upload
+		void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,0,bytes,GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+		std::memcpy(dst,l.data+job.next_row*row_bytes,bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		if (compressed) {
+			int y = job.next_row*4, h = std::min(rows*4,l.height-y);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, job.level, 0, y, l.width, h, pixelFormat(img.format), static_cast<GLsizei>(bytes), nullptr);
+		} else
+			glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.next_row, l.width, rows, pixelFormat(img.format), GL_UNSIGNED_BYTE, nullptr);
+		job.next_row += rows;
+		budget -= std::min(budget,bytes);
+		if (job.next_row<rows_count) break;
+		// this level is complete, so it can be used
+		if (img.levels.size()>1) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+		--job.level; job.next_row = 0;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+	if (job.level>=0) return false;
+
+	if (img.levels.size()==1) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	return true;
+}
+
+TextureResidency &TextureResidency::shared() {
+	static TextureResidency residency;
+	return residency;
+}
+
+void TextureResidency::add(GLuint texture_id, std::future<TextureImage> &&image) {
+	Entry &e = entries[texture_id];
+	e.decoding = std::move(image);
+}
+
+void TextureResidency::add(GLuint texture_id, TextureImage &&image) {
+	Entry &e = entries[texture_id];
+	e.image = std::move(image);
+	if (e.image.isOk()) makeResident(texture_id,e);
+}
+
+void TextureResidency::makeResident(GLuint texture_id, Entry &e) {
+	const TextureImage &img = e.image;
+	int last = static_cast<int>(img.levels.size())-1;
+	e.tail = 0;
+	while (e.tail<last and std::max(img.levels[e.tail].width,img.levels[e.tail].height)>64) ++e.tail;
+	glBindTexture(GL_TEXTURE_2D, texture_id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1); // rows are not padded
+	for(int i=e.tail; i<=last; ++i)
+		defineLevel(img.format,i,img.levels[i],img.levels[i].data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	if (e.tail>0) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // (the placeholder, if any)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, e.tail);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, last);
+	e.base = e.needed = e.wanted = e.tail;
+}
+
+void TextureResidency::request(const Texture &texture, float screen_size) {
+	auto it = entries.find(texture.getId());
+	if (it==entries.end()) return;
+	Entry &e = it->second;
+	if (e.last_request!=frame) e.screen_size = 0.f;
+	e.screen_size = std::max(e.screen_size,screen_size);
+	e.last_request = frame;
+}
+
+std::size_t TextureResidency::memorySize(GLuint texture_id) const {
+	auto it = entries.find(texture_id);
+	if (it==entries.end() or not it->second.image.isOk()) return 0;
+	const Entry &e = it->second;
+	std::size_t bytes = 0;
+	for(int i=e.base; i<static_cast<int>(e.image.levels.size()); ++i)
+		bytes += levelMemorySize(e.image,i);
+	return bytes;
+}
+
+bool TextureResidency::isLoading(GLuint texture_id) const {
+	auto it = entries.find(texture_id);
+	return it!=entries.end() and not it->second.image.isOk() and it->second.decoding.valid();
+}
+
+void TextureResidency::update(std::size_t upload_budget) {
+	Stats st;
+	std::vector<std::pair<GLuint,Entry*>> ready;
+	for(auto &p : entries) {
+		Entry &e = p.second;
+		if (not e.image.isOk()) {
+			if (not e.decoding.valid() or e.decoding.wait_for(std::chrono::seconds(0))!=std::future_status::ready) continue;
+			e.image = e.decoding.get();
+			cg_assert(e.image.isOk(),"Could not load texture");
+			if (not e.image.isOk()) continue; // (keeps the placeholder)
+			makeResident(p.first,e);
+		}
+		ready.emplace_back(p.first,&e);
+	}
+	
+	// finest level needed by each texture (the tail if it was not requested
+	// in this frame); finer levels are kept while they fit in the budget
+	auto bytesFrom = [](const Entry &e, int level) {
+		std::size_t bytes = 0;
+		for(int i=level; i<static_cast<int>(e.image.levels.size()); ++i) bytes += levelMemorySize(e.image,i);
+		return bytes;
+	};
+	std::size_t total = 0;
+	for(auto &p : ready) {
+		Entry &e = *p.second;
+		if (e.last_request!=frame) e.screen_size = 0.f; // (not on screen anymore)
+		e.needed = e.last_request==frame ? neededLevel(e.image,e.screen_size,e.tail) : e.tail;
+		e.wanted = std::min(e.needed,e.base);
+		total += bytesFrom(e,e.wanted);
+		st.needed_bytes += e.last_request==frame ? bytesFrom(e,e.needed) : 0;
+		st.full_bytes += bytesFrom(e,0);
+	}
+	// over the budget, drop first the levels that are not needed, then the
+	// ones of the textures requested less recently, the biggest level first
+	auto lessImportant = [](const Entry &a, const Entry &b) {
+		bool extra_a = a.wanted<a.needed, extra_b = b.wanted<b.needed;
+		if (extra_a!=extra_b) return extra_a;
+		if (a.last_request!=b.last_request) return a.last_request<b.last_request;
+		std::size_t bytes_a = levelMemorySize(a.image,a.wanted), bytes_b = levelMemorySize(b.image,b.wanted);
+		if (bytes_a!=bytes_b) return bytes_a>bytes_b;
+		return a.screen_size<b.screen_size;
+	};
+	while (total>budget) {
+		Entry *victim = nullptr;
+		for(auto &p : ready) {
+			Entry &e = *p.second;
+			if (e.wanted<e.tail and (not victim or lessImportant(e,*victim))) victim = &e;
+		}
+		if (not victim) break; // (only tails left)
+		total -= levelMemorySize(victim->image,victim->wanted);
+		++victim->wanted;
+	}
+	
+	// free the levels that are not wanted anymore
+	for(auto &p : ready) {
+		Entry &e = *p.second;
+		if (e.wanted<=e.base) continue;
+		glBindTexture(GL_TEXTURE_2D, p.first);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, e.wanted);
+		for(int i=e.base; i<e.wanted; ++i) // (a 0x0 image releases its memory)
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		st.dropped_levels += e.wanted-e.base;
+		e.base = e.wanted;
+	}
+	
+	// and upload the missing ones, coarsest first, biggest on screen first
+	std::sort(ready.begin(),ready.end(),[](const std::pair<GLuint,Entry*> &a, const std::pair<GLuint,Entry*> &b) {
+		return a.second->screen_size>b.second->screen_size;
+	});
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	bool uploaded = false;
+	for(bool progress=true; progress; ) {
+		progress = false;
+		for(auto &p : ready) {
+			Entry &e = *p.second;
+			if (e.wanted>=e.base) continue;
+			std::size_t bytes = levelMemorySize(e.image,e.base-1);
+			if (uploaded and bytes>upload_budget) continue;
+			glBindTexture(GL_TEXTURE_2D, p.first);
+			--e.base;
+			defineLevel(e.image.format,e.base,e.image.levels[e.base],e.image.levels[e.base].data);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, e.base);
+			upload_budget -= std::min(upload_budget,bytes);
+			uploaded = progress = true; ++st.loaded_levels;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	
+	for(auto &p : ready) st.resident_bytes += bytesFrom(*p.second,p.second->base);
+	st.textures = static_cast<int>(ready.size());
+	last_stats = st;
+	++frame;
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <sys/stat.h>
+#include <stb_image.h>
+#include "TextureCache.hpp"
+#include "MappedFile.hpp"
+#include "Misc.hpp"
+#include "ThreadPool.hpp"
+#include "Debug.hpp"
+
+// File layout (native endianness, every field 4-byte aligned):
+//   header: magic "CGTC", version, format, levels count
+//   source: path (u32 length + chars, padded to 4), u64 size, i64 modification time
+//   levels: for each one: width, height, u64 size; and then the pixels of
+//           every level (each one padded to 4)
+
+namespace {
+
+const char cache_magic[4] = {'C','G','T','C'};
+const std::uint32_t cache_version = 1;
+
+bool getFileStamp(const std::string &fname, std::uint64_t &size, std::int64_t &mtime) {
+	struct stat st;
+	if (::stat(fname.c_str(),&st)!=0) return false;
+	size = static_cast<std::uint64_t>(st.st_size);
+	mtime = static_cast<std::int64_t>(st.st_mtime);
+	return true;
+}
+
+// bounds-checked sequential reads from the mapped file
+struct Reader {
+	const char *p, *end;
+	bool ok = true;
+	const char *take(std::size_t bytes) {
+		bytes = (bytes+3)&~std::size_t(3);
+		if (not ok or static_cast<std::size_t>(end-p)<bytes) { ok = false; return nullptr; }
+		const char *r = p; p += bytes;
+		return r;
+	}
+	template<typename T> T get() {
+		T v{}; const char *r = take(sizeof(T));
+		if (r) std::memcpy(&v,r,sizeof(T));
+		return v;
+	}
+	std::string getString() {
+		std::uint32_t len = get<std::uint32_t>();
+		const char *r = take(len);
+		return r ? std::string(r,len) : std::string();
+	}
+};
+
+template<typename T>
+void put(std::ostream &f, const T &v) { f.write(reinterpret_cast<const char*>(&v),sizeof(T)); }
+
+void putPadded(std::ostream &f, const void *data, std::size_t bytes) {
+	static const char zeros[4] = {0,0,0,0};
+	f.write(static_cast<const char*>(data),bytes);
+	f.write(zeros,(4-bytes%4)%4);
+}
+
+// every level in a single buffer, levels point into it
+TextureImage allocateLevels(TextureFormat format, int width, int height) {
+	std::vector<TextureLevel> levels;
+	std::size_t total = 0;
+	int block = format==TextureFormat::BC1 ? 8 : 16;
+	for(int w=width, h=height; ; w=std::max(1,w/2), h=std::max(1,h/2)) {
+		TextureLevel l; l.width = w; l.height = h;
+		l.size = isCompressed(format) ? std::size_t((w+3)/4)*((h+3)/4)*block
+		                              : std::size_t(w)*h*channelsCount(format);
+		levels.push_back(l); total += l.size;
+		if (w==1 and h==1) break;
+	}
+	auto buffer = std::make_shared<std::vector<unsigned char>>(total);
+	unsigned char *p = buffer->data();
+	for(TextureLevel &l : levels) { l.data = p; p += l.size; }
+	TextureImage img;
+	img.storage = buffer; img.levels = std::move(levels); img.format = format;
+	return img;
+}
+
+struct Color { int r, g, b; };
+
+int dist2(const Color &a, const Color &b) {
+	return (a.r-b.r)*(a.r-b.r)+(a.g-b.g)*(a.g-b.g)+(a.b-b.b)*(a.b-b.b);
+}
+
+std::uint16_t to565(float r, float g, float b) {
+	auto q = [](float v, int max) { return static_cast<int>(std::min(std::max(v,0.f),255.f)*max/255.f+0.5f); };
+	return static_cast<std::uint16_t>((q(r,31)<<11)|(q(g,63)<<5)|q(b,31));
+}
+
+Color from565(std::uint16_t c) {
+	int r = (c>>11)&31, g = (c>>5)&63, b = c&31;
+	return { (r<<3)|(r>>2), (g<<2)|(g>>4), (b<<3)|(b>>2) };
+}
+
+// endpoints at the extremes of the colors along their principal axis,
+// and for each pixel the nearest of the four colors of the palette
+void encodeColorBlock(const Color px[16], unsigned char *out) {
+	float mean[3] = {0,0,0};
+	for(int i=0;i<16;++i) { mean[0] += px[i].r; mean[1] += px[i].g; mean[2] += px[i].b; }
+	for(float &m : mean) m /= 16.f;
+	float cov[6] = {0,0,0,0,0,0}; // rr rg rb gg gb bb
+	for(int i=0;i<16;++i) {
+		float d[3] = {px[i].r-mean[0], px[i].g-mean[1], px[i].b-mean[2]};
+		cov[0] += d[0]*d[0]; cov[1] += d[0]*d[1]; cov[2] += d[0]*d[2];
+		cov[3] += d[1]*d[1]; cov[4] += d[1]*d[2]; cov[5] += d[2]*d[2];
+	}
+	float axis[3] = {1.f,1.f,1.f}; // power iteration
+	for(int it=0;it<8;++it) {
+		float a[3] = { cov[0]*axis[0]+cov[1]*axis[1]+cov[2]*axis[2],
+		               cov[1]*axis[0]+cov[3]*axis[1]+cov[4]*axis[2],
+		               cov[2]*axis[0]+cov[4]*axis[1]+cov[5]*axis[2] };
+		float len = std::max({std::abs(a[0]),std::abs(a[1]),std::abs(a[2])});
+		if (len<1e-6f) break; // flat block, any axis works
+		for(int k=0;k<3;++k) axis[k] = a[k]/len;
+	}
+	float tmin = 1e9f, tmax = -1e9f;
+	for(int i=0;i<16;++i) {
+		float t = (px[i].r-mean[0])*axis[0]+(px[i].g-mean[1])*axis[1]+(px[i].b-mean[2])*axis[2];
+		tmin = std::min(tmin,t); tmax = std::max(tmax,t);
+	}
+	float len2 = axis[0]*axis[0]+axis[1]*axis[1]+axis[2]*axis[2];
+	tmin /= len2; tmax /= len2;
+	std::uint16_t c0 = to565(mean[0]+axis[0]*tmax,mean[1]+axis[1]*tmax,mean[2]+axis[2]*tmax),
+	              c1 = to565(mean[0]+axis[0]*tmin,mean[1]+axis[1]*tmin,mean[2]+axis[2]*tmin);
+	if (c0<c1) std::swap(c0,c1); // c0>c1 selects the four colors mode
+	std::uint32_t indices = 0;
+	if (c0!=c1) {
+		Color p[4] = { from565(c0), from565(c1) };
+		p[2] = { (2*p[0].r+p[1].r)/3, (2*p[0].g+p[1].g)/3, (2*p[0].b+p[1].b)/3 };
+		p[3] = { (p[0].r+2*p[1].r)/3, (p[0].g+2*p[1].g)/3, (p[0].b+2*p[1].b)/3 };
+		for(int i=0;i<16;++i) {
+			int best = 0;
+			for(int k=1;k<4;++k) if (dist2(px[i],p[k])<dist2(px[i],p[best])) best = k;
+			indices |= std::uint32_t(best)<<(2*i);
+		}
+	}
+	std::memcpy(out,&c0,2); std::memcpy(out+2,&c1,2); std::memcpy(out+4,&indices,4);
+}
+
+// eight values between the min and max alpha of the block
+void encodeAlphaBlock(const int alpha[16], unsigned char *out) {
+	int a0 = *std::max_element(alpha,alpha+16), a1 = *std::min_element(alpha,alpha+16);
+	int values[8] = { a0, a1 };
+	for(int k=1;k<7;++k) values[k+1] = ((7-k)*a0+k*a1)/7;
+	std::uint64_t indices = 0;
+	for(int i=0;i<16;++i) {
+		int best = 0;
+		for(int k=1;k<8;++k) if (std::abs(alpha[i]-values[k])<std::abs(alpha[i]-values[best])) best = k;
+		indices |= std::uint64_t(best)<<(3*i);
+	}
+	out[0] = static_cast<unsigned char>(a0); out[1] = static_cast<unsigned char>(a1);
+	for(int k=0;k<6;++k) out[2+k] = static_cast<unsigned char>(indices>>(8*k));
+}
+
+}
+
+bool isCompressed(TextureFormat format) {
+	return format==TextureFormat::BC1 or format==TextureFormat::BC3;
+}
+
+int channelsCount(TextureFormat format) {
+	return format==TextureFormat::RGB or format==TextureFormat::BC1 ? 3 : 4;
+}
+
+TextureImage decodeTextureImage(const std::string &fname) {
+	// stb_image can flip while loading, but that setting is global (and so
+	// not safe with several threads decoding at the same time)
+	int width, height, channels;
+	if (not stbi_info(fname.c_str(),&width,&height,&channels)) return TextureImage();
+	channels = channels==3 ? 3 : 4; // (gray images are expanded)
+	unsigned char *data = stbi_load(fname.c_str(),&width,&height,nullptr,channels);
+	if (not data) return TextureImage();
+	std::size_t row = std::size_t(width)*channels;
+	std::vector<unsigned char> aux(row);
+	for(int i=0, j=height-1; i<j; ++i, --j) {
+		std::memcpy(aux.data(),data+i*row,row);
+		std::memcpy(data+i*row,data+j*row,row);
+		std::memcpy(data+j*row,aux.data(),row);
+	}
+	TextureImage img;
+	img.storage = std::shared_ptr<const void>(data,stbi_image_free);
+	img.format = channels==3 ? TextureFormat::RGB : TextureFormat::RGBA;
+	TextureLevel level; level.data = data; level.size = row*height;
+	level.width = width; level.height = height;
+	img.levels.push_back(level);
+	return img;
+}
+
+TextureImage generateMipmaps(const TextureImage &src) {
+	cg_assert(src.isOk() and not isCompressed(src.format),"generateMipmaps needs an uncompressed image");
+	TextureImage img = allocateLevels(src.format,src.width(),src.height());
+	std::memcpy(const_cast<unsigned char*>(img.levels[0].data),src.levels[0].data,src.levels[0].size);
+	int c = channelsCount(img.format);
+	for(std::size_t l=1; l<img.levels.size(); ++l) {
+		const TextureLevel &prev = img.levels[l-1], &cur = img.levels[l];
+		unsigned char *dst = const_cast<unsigned char*>(cur.data);
+		ThreadPool::shared().parallelFor(cur.height,[&](int y) {
+			int y0 = std::min(2*y,prev.height-1), y1 = std::min(2*y+1,prev.height-1);
+			for(int x=0; x<cur.width; ++x) {
+				int x0 = std::min(2*x,prev.width-1), x1 = std::min(2*x+1,prev.width-1);
+				for(int k=0; k<c; ++k) {
+					int sum = prev.data[(std::size_t(y0)*prev.width+x0)*c+k] + prev.data[(std::size_t(y0)*prev.width+x1)*c+k]
+					        + prev.data[(std::size_t(y1)*prev.width+x0)*c+k] + prev.data[(std::size_t(y1)*prev.width+x1)*c+k];
+					dst[(std::size_t(y)*cur.width+x)*c+k] = static_cast<unsigned char>((sum+2)/4);
+				}
+			}
+		});
+	}
+	return img;
+}
+
+TextureImage compressTexture(const TextureImage &src) {
+	cg_assert(src.isOk() and not isCompressed(src.format),"compressTexture needs an uncompressed image");
+	int c = channelsCount(src.format);
+	bool opaque = c==3;
+	if (not opaque) {
+		const TextureLevel &l0 = src.levels[0];
+		opaque = true;
+		for(std::size_t i=3; opaque and i<l0.size; i+=4) opaque = l0.data[i]==255;
+	}
+	TextureFormat format = opaque ? TextureFormat::BC1 : TextureFormat::BC3;
+	TextureImage img = allocateLevels(format,src.width(),src.height());
+	img.levels.resize(src.levels.size()); // (only level 0 if src has no mipmaps)
+	int block_size = opaque ? 8 : 16;
+	for(std::size_t l=0; l<img.levels.size(); ++l) {
+		const TextureLevel &in = src.levels[l];
+		unsigned char *out = const_cast<unsigned char*>(img.levels[l].data);
+		int bw = (in.width+3)/4, bh = (in.height+3)/4;
+		ThreadPool::shared().parallelFor(bh,[&](int by) {
+			Color px[16]; int alpha[16];
+			for(int bx=0; bx<bw; ++bx) {
+				for(int i=0; i<16; ++i) { // (pixels outside the image repeat the last row/column)
+					int x = std::min(bx*4+i%4,in.width-1), y = std::min(by*4+i/4,in.height-1);
+					const unsigned char *p = in.data+(std::size_t(y)*in.width+x)*c;
+					px[i] = {p[0],p[1],p[2]}; alpha[i] = c==4 ? p[3] : 255;
+				}
+				unsigned char *block = out+(std::size_t(by)*bw+bx)*block_size;
+				if (not opaque) { encodeAlphaBlock(alpha,block); block += 8; }
+				encodeColorBlock(px,block);
+			}
+		});
+	}
+	return img;
+}
+
+std::size_t textureMemorySize(const TextureImage &img) {
+	std::size_t bytes = 0;
+	for(const TextureLevel &l : img.levels)
+		bytes += isCompressed(img.format) ? l.size : std::size_t(l.width)*l.height*4;
+	if (img.levels.size()==1 and not isCompressed(img.format)) { // the driver will add the mipmaps
+		for(int w=img.width(), h=img.height(); w>1 or h>1; ) {
+			w = std::max(1,w/2); h = std::max(1,h/2);
+			bytes += std::size_t(w)*h*4;
+		}
+	}
+	return bytes;
+}
+
+std::string textureCachePath(const std::string &fname, bool compressed) {
+	return fname+(compressed?".bc.tcache":".tcache");
+}
+
+TextureImage readTextureCache(const std::string &cache_path) {
+	auto file = std::make_shared<MappedFile>(cache_path);
+	if (not file->isOk()) return TextureImage();
+	Reader r{file->begin(),file->end()};
+
+	const char *magic = r.take(4);
+	if (not magic or std::memcmp(magic,cache_magic,4)!=0) return TextureImage();
+	if (r.get<std::uint32_t>()!=cache_version) return TextureImage();
+	std::uint32_t format = r.get<std::uint32_t>(), levels_count = r.get<std::uint32_t>();
+	if (format>static_cast<std::uint32_t>(TextureFormat::BC3)) return TextureImage();
+
+	std::string fname = r.getString();
+	std::uint64_t size = r.get<std::uint64_t>(), cur_size;
+	std::int64_t mtime = r.get<std::int64_t>(), cur_mtime;
+	if (not r.ok or not getFileStamp(fname,cur_size,cur_mtime) or cur_size!=size or cur_mtime!=mtime) {
+		cg_info("Outdated texture cache: "+cache_path);
+		return TextureImage();
+	}
+
+	TextureImage img;
+	img.format = static_cast<TextureFormat>(format);
+	img.levels.resize(levels_count);
+	for(TextureLevel &l : img.levels) {
+		l.width = r.get<std::int32_t>(); l.height = r.get<std::int32_t>();
+		l.size = r.get<std::uint64_t>();
+	}
+	for(TextureLevel &l : img.levels)
+		l.data = reinterpret_cast<const unsigned char*>(r.take(l.size));
+	if (not r.ok or levels_count==0) return TextureImage();
+	img.storage = file;
+	return img;
+}
+
+bool writeTextureCache(const std::string &cache_path, const std::string &source, const TextureImage &img) {
+	std::uint64_t size = 0; std::int64_t mtime = 0;
+	if (not img.isOk() or not getFileStamp(source,size,mtime)) return false;
+	bool saved = replaceFile(cache_path,[&](std::ostream &f) { // (two threads may save the same image at once)
+		f.write(cache_magic,4);
+		put(f,cache_version);
+		put(f,static_cast<std::uint32_t>(img.format));
+		put(f,static_cast<std::uint32_t>(img.levels.size()));
+		put(f,static_cast<std::uint32_t>(source.size()));
+		putPadded(f,source.data(),source.size());
+		put(f,size); put(f,mtime);
+		for(const TextureLevel &l : img.levels) {
+			put(f,static_cast<std::int32_t>(l.width)); put(f,static_cast<std::int32_t>(l.height));
+			put(f,static_cast<std::uint64_t>(l.size));
+		}
+		for(const TextureLevel &l : img.levels)
+			putPadded(f,l.data,l.size);
+		return true;
+	});
+	if (not saved) return false;
+	cg_info("Texture cache saved: "+cache_path);
+	return true;
+}
+
@@ -0,0 +1,67 @@
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include "UniformBlocks.hpp"
+#include "Debug.hpp"
+
+// std140: a vec3 takes 16 bytes unless a float follows it, mat4s are 4 vec4s
+static_assert(offsetof(CameraBlock,light_position)==128 and offsetof(CameraBlock,ambient_strength)==156 
+			  and sizeof(CameraBlock)==160, "CameraBlock does not match the std140 layout");
+static_assert(offsetof(MaterialBlock,shininess)==28 and offsetof(MaterialBlock,specular)==32 
+			  and offsetof(MaterialBlock,texture_layer)==44
+			  and offsetof(MaterialBlock,emission)==48 and sizeof(MaterialBlock)==64, 
+			  "MaterialBlock does not match the std140 layout");
+
+MaterialBlock::MaterialBlock(const Material &m) 
+	: ambient(m.ka), opacity(m.opacity), diffuse(m.kd), shininess(m.shininess),
+	  specular(m.ks), emission(m.ke) {}
+
+void bindUniformBlocks(GLuint program_id) {
+	static const std::pair<const char*,UniformBlockBinding> blocks[] = { {"Camera",ubCamera}, {"Material",ubMaterial} };
+	for(const auto &b : blocks) {
+		GLuint index = glGetUniformBlockIndex(program_id,b.first);
+		if (index!=GL_INVALID_INDEX) glUniformBlockBinding(program_id,index,b.second);
+	}
+}
+
+// buffer currently bound to each binding point (to skip redundant binds)
+static GLuint bound_ubos[2] = {0,0};
+
+void UniformBuffer::update(const void *new_data, int size) {
+	if (ubo!=0 and int(data.size())==size and std::memcmp(data.data(),new_data,size)==0) return;
+	if (ubo==0) glGenBuffers(1,&ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER,ubo);
+	if (int(data.size())==size) glBufferSubData(GL_UNIFORM_BUFFER,0,size,new_data);
+	else glBufferData(GL_UNIFORM_BUFFER,size,new_data,GL_DYNAMIC_DRAW);
+	data.assign(static_cast<const unsigned char*>(new_data),static_cast<const unsigned char*>(new_data)+size);
+}
+
+void UniformBuffer::bind(UniformBlockBinding binding) const {
+	cg_assert(ubo!=0,"UniformBuffer not initialized");
+	if (bound_ubos[binding]==ubo) return;
+	glBindBufferBase(GL_UNIFORM_BUFFER,binding,ubo);
+	bound_ubos[binding] = ubo;
+}
+
+void UniformBuffer::freeResources() {
+	if (ubo==0) return;
+	for(GLuint &b : bound_ubos) if (b==ubo) b = 0; // the id could be reused
+	glDeleteBuffers(1,&ubo);
+}
+
+UniformBuffer::~UniformBuffer() {
+	freeResources();
+}
+
+UniformBuffer::UniformBuffer(UniformBuffer &&other) {
+	*this = static_cast<const UniformBuffer&>(other);
+	other = static_cast<const UniformBuffer&>(UniformBuffer());
+}
+
+UniformBuffer &UniformBuffer::operator=(UniformBuffer &&other) {
+	freeResources();
+	*this = static_cast<const UniformBuffer&>(other);
+	other = static_cast<const UniformBuffer&>(UniformBuffer());
+	return *this;
+}
+
@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cstdint>
+#include "VertexAdjacency.hpp"
+#include "ThreadPool.hpp"
+
+VertexAdjacency::VertexAdjacency(const std::vector<int> &triangles, int vertex_count) 
+	: first(vertex_count+1,0), tris(triangles.size())
+{
+	// each thread owns a range of vertexes and reads all the indexes, but 
+	// only counts and writes the triangles of its own vertexes; so there are 
+	// no concurrent writes, and lists come out sorted as in a serial build
+	int nranges = triangles.size()<(1<<16) ? 1 : std::max(1,ThreadPool::shared().size());
+	auto rangeBegin = [&](int r) { return static_cast<unsigned>(std::int64_t(vertex_count)*r/nranges); };
+	ThreadPool::shared().parallelFor(nranges,[&](int r) {
+		unsigned begin = rangeBegin(r), size = rangeBegin(r+1)-begin;
+		for(int v : triangles) 
+			if (unsigned(v)-begin<size) ++first[v+1];
+	});
+	for(int v=0;v<vertex_count;++v) 
+		first[v+1] += first[v];
+	ThreadPool::shared().parallelFor(nranges,[&](int r) {
+		unsigned begin = rangeBegin(r), size = rangeBegin(r+1)-begin;
+		std::vector<int> next(first.begin()+begin,first.begin()+begin+size);
+		for(std::size_t i=0;i<triangles.size();++i) {
+			unsigned v = unsigned(triangles[i])-begin;
+			if (v<size) tris[next[v]++] = i/3;
+		}
+	});
+}
+
+void VertexAdjacency::oneRing(int v, const std::vector<int> &triangles, std::vector<int> &ring) const {
+	ring.clear();
+	for(int t : trianglesAround(v)) 
+		for(int k=0;k<3;++k) 
+			if (triangles[3*t+k]!=v) ring.push_back(triangles[3*t+k]);
+	std::sort(ring.begin(),ring.end());
+	ring.erase(std::unique(ring.begin(),ring.end()),ring.end());
+}
+
+void VertexAdjacency::oneRing(const std::vector<int> &vertexes, const std::vector<int> &triangles, std::vector<int> &ring) const {
+	ring.clear();
+	for(int v : vertexes) {
+		for(int t : trianglesAround(v)) 
+			ring.insert(ring.end(),&triangles[3*t],&triangles[3*t]+3);
+	}
+	std::sort(ring.begin(),ring.end());
+	ring.erase(std::unique(ring.begin(),ring.end()),ring.end());
+}
@@ -2,7 +2,8 @@
 #include "Delaunay.hpp"
 #include "Debug.hpp"
 
-DelaunayRenderer::DelaunayRenderer() : shader("shaders/delaunay") { 
+DelaunayRenderer::DelaunayRenderer() { 
+	shader.loadDeferred("shaders/delaunay");
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 	
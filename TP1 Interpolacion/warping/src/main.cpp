@@ -61,8 +61,9 @@ int main() {
 	glClearColor(0.2f,0.2f,0.5f,1.f);
 	
 	// model and triangulation
-	Shader shader_phong("shaders/phong"),
-		   shader_wire("shaders/wireframe");
+	Shader shader_phong, shader_wire; // compiled at the same time (see loadDeferred)
+	shader_phong.loadDeferred("shaders/phong");
+	shader_wire.loadDeferred("shaders/wireframe");
 	int loaded_model = -1;
 	std::vector<Model> models;
 	DelaunayRenderer delaunay_renderer;
@@ -87,10 +88,10 @@ int main() {
 			shader.setLight(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
 			// aplicar deformacion
 			auto func = apply_warp?applyWarp:restoreGeometry;
-			func(delaunay0,delaunay1,part.geometry,part.buffers);
-			shader.setBuffers(part.buffers);
+			func(delaunay0,delaunay1,part.geometry,*part.buffers);
+			shader.setBuffers(*part.buffers);
 			shader.setMaterial(part.material);
-			part.buffers.draw();
+			part.draw();
 		}
 		
 		// dibujar la triangulacion
@@ -165,13 +166,15 @@ glm::vec3 warpPoint(const Delaunay &delaunay0, const Delaunay &delaunay1, glm::v
 void applyWarp(const Delaunay &delaunay0, const Delaunay &del_new,
 			   const Geometry &geometry, GeometryRenderer &renderer) 
 {
-	// obtener vertices deformados
-	Geometry new_geom;
-	new_geom.positions.reserve(geometry.positions.size());
+	// obtener vertices deformados (new_geom se reutiliza entre cuadros para
+	// no reservar memoria cada vez)
+	static Geometry new_geom;
+	new_geom.positions.clear();
 	for(glm::vec3 p : geometry.positions)
 		new_geom.positions.push_back( warpPoint(delaunay0,delaunay1,p) );
 	
-	// recalcular normales y enviar los nuevos datos a la gpu
+	// recalcular normales y enviar los nuevos datos a la gpu (el modelo se
+	// carga con fDynamic, asi que draw() los sube sin esperar a la gpu)
 	new_geom.triangles = geometry.triangles;
 	new_geom.generateNormals();
 	renderer.updatePositions(new_geom.positions,false);
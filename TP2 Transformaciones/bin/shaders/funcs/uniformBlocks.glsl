@@ -0,0 +1,22 @@
+// uniform blocks shared by all programs (the layouts must match the structs
+// in UniformBlocks.hpp)
+
+// updated once per frame (CameraBlock)
+layout(std140) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec4 lightPosition;
+	vec3 lightColor;
+	float ambientStrength;
+};
+
+// one per material (MaterialBlock, see Model::material_buffer)
+layout(std140) uniform Material {
+	vec3 ambientColor;
+	float opacity;
+	vec3 diffuseColor;
+	float shininess;
+	vec3 specularColor;
+	float textureLayer; // for sampler2DArray (see Model::texture_layer)
+	vec3 emissionColor;
+};
@@ -4,17 +4,8 @@ in vec3 fragNormal;
 in vec3 fragPosition;
 in vec4 lightVSPosition;
 
-// propiedades del material
-uniform vec3 ambientColor;
-uniform vec3 specularColor;
-uniform vec3 diffuseColor;
-uniform vec3 emissionColor;
-uniform float opacity;
-uniform float shininess;
-
-// propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+// propiedades del material y de la luz
+#include "funcs/uniformBlocks.glsl"
 
 out vec4 fragColor;
 
@@ -2,19 +2,21 @@
 
 in vec3 vertexPosition;
 in vec3 vertexNormal;
+in mat4 instanceMatrix; // identity if not instanced (see Shader::setBuffers)
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+uniform mat3 normalMatrix; // inverse transpose of view*model (see Shader::setModelMatrix)
+
+#include "funcs/uniformBlocks.glsl"
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec4 lightVSPosition;
 
 void main() {
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
-	fragPosition = vec3(modelMatrix * vec4(vertexPosition,1.f));
-	fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	mat4 model = modelMatrix * instanceMatrix;
+	gl_Position = projectionMatrix * viewMatrix * model * vec4(vertexPosition,1.f);
+	fragPosition = vec3(model * vec4(vertexPosition,1.f));
+	fragNormal = normalMatrix * mat3(instanceMatrix) * vertexNormal; // (instances must not have non-uniform scales)
 	lightVSPosition = viewMatrix * lightPosition;
 }
@@ -4,8 +4,9 @@ in vec3 vertexPosition;
 in vec2 vertexTexCoords;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+
+#include "funcs/uniformBlocks.glsl"
+
 out vec2 fragTexCoords;
 
 void main() {
@@ -0,0 +1,39 @@
+#include <clocale>
+#include <cstdlib>
+#include <string>
+#include "FastParse.hpp"
+
+namespace fast_parse_detail {
+
+bool parseFloatFallback(const char *&p, const char *end, float &value) {
+	auto isDigit = [](char c) { return static_cast<unsigned>(c-'0')<10u; };
+	// find the end of the number (same grammar as the fast path)
+	const char *q = p;
+	if (q!=end and (*q=='-' or *q=='+')) ++q;
+	while (q!=end and isDigit(*q)) ++q;
+	if (q!=end and *q=='.') ++q;
+	while (q!=end and isDigit(*q)) ++q;
+	if (q!=end and (*q=='e' or *q=='E')) {
+		const char *e = q+1;
+		if (e!=end and (*e=='-' or *e=='+')) ++e;
+		if (e!=end and isDigit(*e)) {
+			while (e!=end and isDigit(*e)) ++e;
+			q = e;
+		}
+	}
+	// let strtof do the rounding, but on a null-terminated copy where the
+	// dot is replaced by the current locale's decimal separator
+	std::string s(p,q);
+	const char *dp = std::localeconv()->decimal_point;
+	auto pos = s.find('.');
+	if (pos!=std::string::npos and dp and dp[0]!='.')
+		s.replace(pos,1,dp);
+	char *s_end;
+	float f = std::strtof(s.c_str(),&s_end);
+	if (s_end==s.c_str()) return false;
+	value = f; p = q;
+	return true;
+}
+
+}
+
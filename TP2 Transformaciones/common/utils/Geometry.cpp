@@ -1,46 +1,237 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <glm/ext.hpp>
 #include "Geometry.hpp"
 #include "Debug.hpp"
+#include "ThreadPool.hpp"
 
-template<typename vector>
-static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic) {
+static void updateBuffer(GLenum type, GLuint &id, const void *data, std::size_t bytes, bool realloc, bool dynamic, std::size_t offset=0) {
 	if (id==0) {
 		cg_assert(realloc,"Texture coordinates not initialized");
 		glGenBuffers(1, &id);
 	}
 	glBindBuffer(type, id);
 	if (realloc) {
-		glBufferData(type, v.size()*sizeof(typename vector::value_type), v.data(), dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+		glBufferData(type, bytes, data, dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
 	} else
-		glBufferSubData(type, 0, v.size()*sizeof(typename vector::value_type), v.data());
+		glBufferSubData(type, offset, bytes, data);
+}
+
+template<typename vector>
+static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic) {
+	updateBuffer(type,id,v.data(),v.size()*sizeof(typename vector::value_type),realloc,dynamic);
+}
+
+// copies count elements into a buffer with a different stride
+static void copyStrided(char *dst, std::size_t stride, const void *src, std::size_t element_size, int count) {
+	const char *csrc = static_cast<const char*>(src);
+	for(int i=0;i<count;++i) 
+		std::memcpy(dst+i*stride,csrc+i*element_size,element_size);
+}
+
+// how each attribute is stored, for the float and compact formats
+struct AttribFormat { GLint size; GLenum type; GLboolean normalized; std::size_t bytes; };
+static const AttribFormat position_formats[2] = { {3,GL_FLOAT,GL_FALSE,sizeof(glm::vec3)}, 
+                                                  {3,GL_UNSIGNED_SHORT,GL_TRUE,4*sizeof(std::uint16_t)} };
+static const AttribFormat normal_formats[2] = { {3,GL_FLOAT,GL_FALSE,sizeof(glm::vec3)}, 
+                                                {2,GL_SHORT,GL_TRUE,2*sizeof(std::int16_t)} };
+static const AttribFormat tex_coords_formats[2] = { {2,GL_FLOAT,GL_FALSE,sizeof(glm::vec2)}, 
+                                                    {2,GL_UNSIGNED_SHORT,GL_TRUE,2*sizeof(std::uint16_t)} };
+
+GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic, int format) {
+	cg_assert(geo.normals.empty() or geo.normals.size()==geo.positions.size(),"Wrong normals count");
+	cg_assert(geo.tex_coords.empty() or geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
+	init(geo.positions.data(), 
+		 geo.normals.empty() ? nullptr : geo.normals.data(),
+		 geo.tex_coords.empty() ? nullptr : geo.tex_coords.data(),
+		 geo.positions.size(), 
+		 geo.triangles.empty() ? nullptr : geo.triangles.data(),
+		 geo.triangles.size(), dynamic, format);
+}
+
+GeometryRenderer::GeometryRenderer(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+								   int vertex_count, const int *triangles, int index_count, bool dynamic, int format) 
+{
+	init(positions,normals,tex_coords,vertex_count,triangles,index_count,dynamic,format);
 }
 
-GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic) {
+VertexAttrib &GeometryRenderer::attrib(int i) {
+	return i==aPositions ? layout.positions : (i==aNormals ? layout.normals : layout.tex_coords);
+}
+
+GLuint &GeometryRenderer::vertexBuffer(int i) {
+	return i==aPositions ? VBO_pos : (i==aNormals ? VBO_norms : VBO_tcs);
+}
+
+void GeometryRenderer::init(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+							int vertex_count, const int *triangles, int index_count, bool dynamic, int format) 
+{
+	cg_assert(vertex_count,"Empty Geometry");
+	this->format = format;
+	this->vertex_count = vertex_count;
 	
-	cg_assert(geo.positions.size(),"Empty Geometry");
+	// attributes layout (buffers are set when uploading)
+	int ifmt = isCompact() ? 1 : 0;
+	const AttribFormat *formats[attrib_count] = { &position_formats[ifmt], &normal_formats[ifmt], &tex_coords_formats[ifmt] };
+	bool present[attrib_count] = { true, normals!=nullptr, tex_coords!=nullptr };
+	std::size_t vertex_size = 0;
+	for(int i=0;i<attrib_count;++i) {
+		attrib(i).size = formats[i]->size; 
+		attrib(i).type = formats[i]->type;
+		attrib(i).normalized = formats[i]->normalized;
+		attrib(i).stride = formats[i]->bytes;
+		if (isInterleaved() and present[i]) {
+			attrib(i).offset = vertex_size;
+			vertex_size += formats[i]->bytes;
+		}
+	}
 	
 	glGenVertexArrays(1,&VAO);
 	glBindVertexArray(VAO);
 	
-	updateBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,true,dynamic);
-	
-	if (not geo.normals.empty()) {
-		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,true,dynamic);  
-	}
-	if (not geo.tex_coords.empty()) {
-		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,true, dynamic);  
+	// interleaved and stream buffers are allocated here, and then attributes
+	// are written in place
+	if (isInterleaved() or isStream()) {
+		std::size_t copies = isStream() ? stream_slots : 1;
+		for(int i=0;i<attrib_count;++i) {
+			if (not present[i]) continue;
+			int ibuf = isInterleaved() ? aPositions : i;
+			if (isInterleaved()) attrib(i).stride = vertex_size;
+			std::size_t bytes = vertex_count*std::size_t(attrib(i).stride);
+			GLuint &vbo = vertexBuffer(ibuf);
+			if (vbo==0) updateBuffer(GL_ARRAY_BUFFER,vbo,nullptr,bytes*copies,true,dynamic or isStream());
+			attrib(i).buffer = vbo;
+			if (isStream()) stream_data[ibuf].resize(bytes);
+		}
 	}
-	if (not geo.triangles.empty()) {
-		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,geo.triangles,true,dynamic);
-		count = geo.triangles.size();
+	bool realloc = not (isInterleaved() or isStream());
+	uploadPositions(positions,vertex_count,realloc,dynamic);
+	if (normals) uploadNormals(normals,vertex_count,realloc,dynamic);
+	if (tex_coords) uploadTexCoords(tex_coords,vertex_count,realloc,dynamic);
+	if (triangles and index_count) {
+		uploadElements(triangles,index_count,true,dynamic);
+		count = index_count;
 	} else 
-		count = geo.positions.size();
+		count = vertex_count;
 	
 	glBindVertexArray(0);
 }
 
+void GeometryRenderer::uploadPositions(const glm::vec3 *positions, int vertex_count, bool realloc, bool dynamic) {
+	if (not isCompact()) {
+		uploadAttrib(aPositions,positions,sizeof(glm::vec3),0,vertex_count,realloc,dynamic);
+		return;
+	}
+	std::vector<std::uint16_t> q;
+	quantizePositions(positions,vertex_count,q,decode);
+	uploadAttrib(aPositions,q.data(),4*sizeof(std::uint16_t),0,vertex_count,realloc,dynamic);
+}
+
+void GeometryRenderer::uploadNormals(const glm::vec3 *normals, int vertex_count, bool realloc, bool dynamic) {
+	if (not isCompact()) {
+		uploadAttrib(aNormals,normals,sizeof(glm::vec3),0,vertex_count,realloc,dynamic);
+		return;
+	}
+	std::vector<std::int16_t> q;
+	encodeNormals(normals,vertex_count,q,decode);
+	uploadAttrib(aNormals,q.data(),2*sizeof(std::int16_t),0,vertex_count,realloc,dynamic);
+}
+
+void GeometryRenderer::uploadTexCoords(const glm::vec2 *tex_coords, int vertex_count, bool realloc, bool dynamic) {
+	if (not isCompact()) {
+		uploadAttrib(aTexCoords,tex_coords,sizeof(glm::vec2),0,vertex_count,realloc,dynamic);
+		return;
+	}
+	std::vector<std::uint16_t> q;
+	quantizeTexCoords(tex_coords,vertex_count,q,decode);
+	uploadAttrib(aTexCoords,q.data(),2*sizeof(std::uint16_t),0,vertex_count,realloc,dynamic);
+}
+
+void GeometryRenderer::uploadAttrib(int i, const void *data, std::size_t element_size, 
+									int first_vertex, int vertex_count, bool realloc, bool dynamic) 
+{
+	VertexAttrib &attrib = this->attrib(i);
+	if (isStream()) { // just update the copy in RAM, draw() will upload it
+		cg_assert(attrib.buffer!=0,"Attribute not present in the stream buffers");
+		cg_assert(first_vertex+vertex_count<=this->vertex_count,"Stream buffers can not change their vertex count");
+		char *dst = stream_data[isInterleaved()?aPositions:i].data()+attrib.offset;
+		copyStrided(dst+first_vertex*std::size_t(attrib.stride),attrib.stride,data,element_size,vertex_count);
+		stream_dirty = true;
+		return;
+	}
+	if (not isInterleaved()) {
+		cg_assert(not realloc or first_vertex==0,"Can not realloc with a partial update");
+		updateBuffer(GL_ARRAY_BUFFER,vertexBuffer(i),data,vertex_count*element_size,realloc,dynamic,first_vertex*element_size);
+		attrib.buffer = vertexBuffer(i);
+		return;
+	}
+	// interleaved: write only this attribute's bytes of each vertex (mapping 
+	// without invalidating, so the other attributes are preserved)
+	cg_assert(attrib.buffer!=0,"Attribute not present in the interleaved buffer");
+	cg_assert(first_vertex+vertex_count<=this->vertex_count,"Interleaved buffers can not change their vertex count");
+	glBindBuffer(GL_ARRAY_BUFFER,attrib.buffer);
+	std::size_t stride = attrib.stride;
+	char *dst = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER,first_vertex*stride,vertex_count*stride,GL_MAP_WRITE_BIT));
+	cg_assert(dst!=nullptr,"Could not map the vertex buffer");
+	copyStrided(dst+attrib.offset,stride,data,element_size,vertex_count);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+std::size_t GeometryRenderer::memorySize() const {
+	std::size_t vertex_bytes = 0;
+	if (isInterleaved()) 
+		vertex_bytes = layout.positions.stride;
+	else
+		for(const VertexAttrib *a : {&layout.positions,&layout.normals,&layout.tex_coords})
+			if (a->buffer) vertex_bytes += a->stride;
+	return vertex_count*vertex_bytes*(isStream() ? stream_slots : 1)
+		 + index_count*std::size_t(index_type==GL_UNSIGNED_SHORT ? 2 : 4)
+		 + instances.memorySize();
+}
+
+void GeometryRenderer::uploadElements(const int *triangles, int index_count, bool realloc, bool dynamic) {
+	bool fits_short = isCompact() and (index_count==0 or *std::max_element(triangles,triangles+index_count)<=0xFFFF);
+	if (realloc) {
+		index_type = fits_short ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		this->index_count = index_count;
+	}
+	if (index_type==GL_UNSIGNED_INT) {
+		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,triangles,index_count*sizeof(int),realloc,dynamic);
+		return;
+	}
+	cg_assert(fits_short,"Index out of range for a 16-bit index buffer (use realloc)");
+	std::vector<std::uint16_t> q(triangles,triangles+index_count);
+	updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,q,realloc,dynamic);
+}
+
+void GeometryRenderer::flushStream() const {
+	// move to the next copy; if the GPU may still be reading from it (its 
+	// fence is not signaled yet), orphan the buffers instead of waiting
+	stream_slot = (stream_slot+1)%stream_slots;
+	GLsync &fence = stream_fences[stream_slot];
+	bool busy = fence and glClientWaitSync(fence,0,0)==GL_TIMEOUT_EXPIRED;
+	if (busy) { // new storage: no copy is in use anymore
+		for(GLsync &f : stream_fences) { 
+			if (f) glDeleteSync(f); 
+			f = nullptr;
+		}
+	}
+	const GLuint vbos[attrib_count] = { VBO_pos, VBO_norms, VBO_tcs };
+	for(int i=0;i<attrib_count;++i) {
+		const std::vector<char> &data = stream_data[i];
+		if (data.empty()) continue;
+		glBindBuffer(GL_ARRAY_BUFFER,vbos[i]);
+		if (busy) glBufferData(GL_ARRAY_BUFFER,data.size()*stream_slots,nullptr,GL_DYNAMIC_DRAW);
+		void *dst = glMapBufferRange(GL_ARRAY_BUFFER,stream_slot*data.size(),data.size(),
+									 GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_RANGE_BIT|GL_MAP_UNSYNCHRONIZED_BIT);
+		cg_assert(dst!=nullptr,"Could not map the vertex buffer");
+		std::memcpy(dst,data.data(),data.size());
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	stream_dirty = false;
+}
+
 GeometryRenderer::GeometryRenderer(GeometryRenderer &&geo) {
 	*this = static_cast<const GeometryRenderer&>(geo);
 	geo = static_cast<const GeometryRenderer&>(GeometryRenderer());
@@ -54,18 +245,91 @@ GeometryRenderer &GeometryRenderer::operator=(GeometryRenderer &&geo) {
 }
 
 void GeometryRenderer::draw() const {
+	drawCall(first,count,0);
+}
+
+void GeometryRenderer::draw(int first, int count) const {
+	drawCall(first,count,0);
+}
+
+void GeometryRenderer::drawInstanced() const {
+	cg_assert(instances.isOk(),"Instance matrixes not set");
+	if (instances.count()>0) drawCall(first,count,instances.count());
+}
+
+void GeometryRenderer::drawInstanced(int instance_count, int first, int count) const {
+	if (instance_count>0) drawCall(first,count,instance_count);
+}
+
+void GeometryRenderer::drawCall(int first, int count, int instance_count) const {
+	if (stream_dirty) flushStream();
+	// with fStream, the copy in use is selected with the base vertex (so
+	// attribute pointers are always the same)
+	int base_vertex = isStream() ? stream_slot*vertex_count : 0;
 	glBindVertexArray(VAO);
-	if (EBO) glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
-	else glDrawArrays(GL_TRIANGLES, 0,count);
+	if (EBO) {
+		std::size_t index_size = index_type==GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(int);
+		const void *offset = reinterpret_cast<const void*>(first*index_size);
+		if (instance_count) glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, index_type, offset, instance_count, base_vertex);
+		else if (base_vertex) glDrawElementsBaseVertex(GL_TRIANGLES, count, index_type, offset, base_vertex);
+		else glDrawElements(GL_TRIANGLES, count, index_type, offset);
+	} else {
+		if (instance_count) glDrawArraysInstanced(GL_TRIANGLES, first+base_vertex, count, instance_count);
+		else glDrawArrays(GL_TRIANGLES, first+base_vertex,count);
+	}
 	glBindVertexArray(0);
+	if (isStream()) { // signaled when the GPU is done with this draw
+		GLsync &fence = stream_fences[stream_slot];
+		if (fence) glDeleteSync(fence);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+	}
+}
+
+void InstanceBuffer::update(const glm::mat4 *matrixes, int count) {
+	if (VBO==0) glGenBuffers(1,&VBO);
+	glBindBuffer(GL_ARRAY_BUFFER,VBO);
+	// always new storage (orphaning the previous one, that the GPU may be 
+	// still reading), but it only grows so the driver can recycle it
+	capacity = std::max(capacity,count);
+	glBufferData(GL_ARRAY_BUFFER,capacity*sizeof(glm::mat4),nullptr,GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER,0,count*sizeof(glm::mat4),matrixes);
+	instance_count = count;
+}
+
+void InstanceBuffer::freeResources() {
+	if (VBO) glDeleteBuffers(1,&VBO);
+	VBO = 0; instance_count = capacity = 0; // (GeometryRenderer frees it before its destructor)
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	freeResources();
+}
+
+InstanceBuffer::InstanceBuffer(InstanceBuffer &&other) {
+	*this = static_cast<const InstanceBuffer&>(other);
+	other = static_cast<const InstanceBuffer&>(InstanceBuffer());
+}
+
+InstanceBuffer &InstanceBuffer::operator=(InstanceBuffer &&other) {
+	freeResources();
+	*this = static_cast<const InstanceBuffer&>(other);
+	other = static_cast<const InstanceBuffer&>(InstanceBuffer());
+	return *this;
+}
+
+void GeometryRenderer::setDrawRange(int first, int count) {
+	this->first = first; this->count = count;
 }
 
 void GeometryRenderer::freeResources() {
+	instances.freeResources();
 	if (VAO==0) return;
 	if (VBO_pos) glDeleteBuffers(1,&VBO_pos);
 	if (VBO_norms) glDeleteBuffers(1,&VBO_norms);
 	if (VBO_tcs) glDeleteBuffers(1,&VBO_tcs);
 	if (EBO) glDeleteBuffers(1,&EBO);
+	for(GLsync fence : stream_fences) 
+		if (fence) glDeleteSync(fence);
 	glDeleteVertexArrays(1,&VAO);
 }
 GeometryRenderer::~GeometryRenderer() {
@@ -73,42 +337,132 @@ GeometryRenderer::~GeometryRenderer() {
 }
 
 void GeometryRenderer::updateTexCoords (const std::vector<glm::vec2> &vtc, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_tcs,vtc,realloc,dynamic);
+	uploadTexCoords(vtc.data(),vtc.size(),realloc,dynamic);
 }
 
 void GeometryRenderer::updatePositions (const std::vector<glm::vec3> &vp, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_pos,vp,realloc,dynamic);
+	uploadPositions(vp.data(),vp.size(),realloc,dynamic);
 }
 
 void GeometryRenderer::updateNormals (const std::vector<glm::vec3> &vn, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_norms,vn,realloc,dynamic);
+	uploadNormals(vn.data(),vn.size(),realloc,dynamic);
 }
 
 void GeometryRenderer::updateElements(const std::vector<int> &ve, bool realloc, bool dynamic) {
-	updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,ve,realloc,dynamic);
+	uploadElements(ve.data(),ve.size(),realloc,dynamic);
+}
+
+void GeometryRenderer::updateTexCoords(const glm::vec2 *vtc, int first_vertex, int count) {
+	cg_assert(not isCompact(),"Compact texture coordinates can not be partially updated");
+	uploadAttrib(aTexCoords,vtc,sizeof(glm::vec2),first_vertex,count,false,false);
+}
+
+void GeometryRenderer::updatePositions(const glm::vec3 *vp, int first_vertex, int count) {
+	cg_assert(not isCompact(),"Compact positions can not be partially updated");
+	uploadAttrib(aPositions,vp,sizeof(glm::vec3),first_vertex,count,false,false);
+}
+
+void GeometryRenderer::updateNormals(const glm::vec3 *vn, int first_vertex, int count) {
+	if (not isCompact()) {
+		uploadAttrib(aNormals,vn,sizeof(glm::vec3),first_vertex,count,false,false);
+		return;
+	}
+	std::vector<std::int16_t> q;
+	encodeNormals(vn,count,q,decode);
+	uploadAttrib(aNormals,q.data(),2*sizeof(std::int16_t),first_vertex,count,false,false);
+}
+
+// runs f(begin,end) over [0;n), split in blocks processed in parallel
+template<typename F>
+static void forEachBlock(int n, F &&f) {
+	const int block_size = 1<<15;
+	int nblocks = (n+block_size-1)/block_size;
+	if (nblocks<=1) { 
+		f(0,n); 
+		return; 
+	}
+	ThreadPool::shared().parallelFor(nblocks,[&](int b) { 
+		f(b*block_size,std::min(n,(b+1)*block_size)); 
+	});
+}
+
+static glm::vec3 triangleNormal(const std::vector<glm::vec3> &positions, const int *t) {
+	return glm::cross( (positions[t[2]]-positions[t[1]]), (positions[t[0]]-positions[t[1]]) );
+}
+
+// normal of vertex v, from the normals of its triangles
+static glm::vec3 gatherNormal(const Geometry &g, const VertexAdjacency &adjacency, int v) {
+	glm::vec3 n(0.f);
+	for(int t : adjacency.trianglesAround(v)) 
+		n += triangleNormal(g.positions,&g.triangles[3*t]);
+	return glm::dot(n,n)!=0 ? glm::normalize(n) : n;
 }
 
 void Geometry::generateNormals ( ) {
 	normals.clear();
 	normals.resize(positions.size());
+	int vertex_count = positions.size();
+	if (triangles.empty()) {
+		forEachBlock(vertex_count/3,[&](int begin, int end) {
+			for(int i=3*begin;i<3*end;i+=3)
+				normals[i] = normals[i+1] = normals[i+2] = 
+					glm::normalize(
+						glm::cross(
+							(positions[i+2]-positions[i+1]),
+							(positions[i+0]-positions[i+1]) ) );
+		});
+		return;
+	}
+	// each thread owns a range of vertexes and adds to them the normals of 
+	// the triangles that touch it, so no two threads write the same normal;
+	// every thread reads all the indexes, but computes only its triangles, 
+	// and in the same order as a serial loop (so results are the same)
+	int nranges = triangles.size()<(1<<16) ? 1 : std::max(1,ThreadPool::shared().size());
+	ThreadPool::shared().parallelFor(nranges,[&](int r) {
+		unsigned begin = std::int64_t(vertex_count)*r/nranges;
+		unsigned size = std::int64_t(vertex_count)*(r+1)/nranges - begin;
+		for(std::size_t i=0;i<triangles.size();i+=3) {
+			const int *t = &triangles[i];
+			bool own[3] = { t[0]-begin<size, t[1]-begin<size, t[2]-begin<size };
+			if (not (own[0] or own[1] or own[2])) continue;
+			glm::vec3 n = triangleNormal(positions,t);
+			for(int j=0;j<3;++j) 
+				if (own[j]) normals[t[j]] += n;
+		}
+		for(unsigned v=begin;v<begin+size;++v) 
+			if (glm::dot(normals[v],normals[v])!=0) 
+				normals[v] = glm::normalize(normals[v]);
+	});
+}
+
+const VertexAdjacency &Geometry::adjacency() const {
+	if (adjacency_cache.vertexCount()!=int(positions.size()) or adjacency_cache.indexCount()!=int(triangles.size()))
+		adjacency_cache = VertexAdjacency(triangles,positions.size());
+	return adjacency_cache;
+}
+
+void Geometry::updateNormals(const std::vector<int> &moved_vertices) {
+	cg_assert(normals.size()==positions.size(),"Normals not generated");
+	if (moved_vertices.size()>positions.size()/64) { // scattered reads, cheaper to redo everything
+		generateNormals();
+		return;
+	}
 	if (triangles.empty()) {
-		for(size_t i=0;i<positions.size();i+=3)
+		for(int v : moved_vertices) {
+			int i = v-v%3;
 			normals[i] = normals[i+1] = normals[i+2] = 
-				glm::normalize(
-					glm::cross(
-						(positions[i+2]-positions[i+1]),
-						(positions[i+0]-positions[i+1]) ) );
-	} else {
-		for(size_t i=0;i<triangles.size();i+=3) {
-			auto n = glm::cross( (positions[triangles[i+2]]-positions[triangles[i+1]]),
-								 (positions[triangles[i+0]]-positions[triangles[i+1]]) );
-			normals[triangles[i+0]] += n;
-			normals[triangles[i+1]] += n;
-			normals[triangles[i+2]] += n;
+				glm::normalize(glm::cross( (positions[i+2]-positions[i+1]), (positions[i+0]-positions[i+1]) ));
 		}
-		for(auto &n : normals) 
-			if (glm::dot(n,n)!=0) 
-				n = glm::normalize(n);
-	}	
+		return;
+	}
+	// moving a vertex changes its triangles' normals, so every vertex of 
+	// those triangles (the one-ring) needs a new normal
+	const VertexAdjacency &adjacency = this->adjacency();
+	std::vector<int> affected;
+	adjacency.oneRing(moved_vertices,triangles,affected);
+	forEachBlock(affected.size(),[&](int begin, int end) {
+		for(int i=begin;i<end;++i) 
+			normals[affected[i]] = gatherNormal(*this,adjacency,affected[i]);
+	});
 }
 
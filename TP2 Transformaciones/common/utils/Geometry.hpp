@@ -5,41 +5,160 @@
 #include <glad/glad.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include "VertexAdjacency.hpp"
+#include "VertexQuantization.hpp"
 
 struct Geometry {
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> tex_coords;
 	std::vector<int> triangles;
+	// area weighted vertex normals (in parallel for big meshes)
 	void generateNormals();
+	// recomputes only the normals that change when the given vertexes are 
+	// moved (theirs and their neighbors')
+	void updateNormals(const std::vector<int> &moved_vertices);
 	
+	// vertex->triangles adjacency, built on first use and then cached (the
+	// first call is not thread safe); call trianglesChanged() after modifying
+	// triangles (it is also rebuilt if the number of vertexes or indexes changes)
+	const VertexAdjacency &adjacency() const;
+	void trianglesChanged() { adjacency_cache = VertexAdjacency(); }
+	
+private:
+	mutable VertexAdjacency adjacency_cache;
+};
+
+// where and how each vertex attribute is stored (arguments for glVertexAttribPointer)
+struct VertexAttrib {
+	GLuint buffer = 0; // 0 if the geometry does not have this attribute
+	GLint size = 0;
+	GLenum type = GL_FLOAT;
+	GLboolean normalized = GL_FALSE;
+	GLsizei stride = 0;
+	std::size_t offset = 0;
+};
+
+struct VertexLayout {
+	VertexAttrib positions, normals, tex_coords;
+};
+
+// per instance model matrixes for instanced draws (Shader::setBuffers binds
+// them to the shader's instanceMatrix attribute); apart from the vertexes so
+// models that share a GeometryRenderer can draw different instances
+class InstanceBuffer {
+public:
+	InstanceBuffer() = default;
+	InstanceBuffer(InstanceBuffer &&other);
+	InstanceBuffer &operator=(InstanceBuffer &&other);
+	~InstanceBuffer();
+	void update(const glm::mat4 *matrixes, int count);
+	void update(const std::vector<glm::mat4> &matrixes) { update(matrixes.data(),matrixes.size()); }
+	bool isOk() const { return VBO!=0; }
+	GLuint getId() const { return VBO; }
+	int count() const { return instance_count; }
+	std::size_t memorySize() const { return capacity*sizeof(glm::mat4); }
+private:
+	friend class GeometryRenderer; // (it has one, and copies it the same way when moved)
+	InstanceBuffer &operator=(const InstanceBuffer &other) = default;
+	void freeResources();
+	GLuint VBO = 0;
+	int instance_count = 0, capacity = 0;
 };
 
 class GeometryRenderer {
 public:
+	// format flags: fCompact uploads quantized vertexes and 16-bit indexes
+	// when possible (see VertexQuantization.hpp; the shader must decode them),
+	// fInterleaved puts all the attributes of a vertex together in a single 
+	// buffer, and fStream is for vertexes updated every frame: the GPU keeps
+	// a ring of three copies, update* only change a copy in RAM, and draw()
+	// uploads it to a copy the GPU is not using anymore (checked with fences,
+	// without waiting), so the CPU never stalls on a buffer still being drawn
+	enum Format { fSeparate=0, fCompact=1, fInterleaved=2, fStream=4 };
+	
 	GeometryRenderer() = default;
-	GeometryRenderer(const Geometry &geo, bool dynamic=false);
+	GeometryRenderer(const Geometry &geo, bool dynamic=false, int format=fSeparate);
+	// same, but from raw arrays (normals and tex_coords can be null; 
+	// if triangles is null, vertexes are drawn as consecutive triangles)
+	GeometryRenderer(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+					 int vertex_count, const int *triangles, int index_count, bool dynamic=false, int format=fSeparate);
 	GeometryRenderer(GeometryRenderer &&geo);
 	GeometryRenderer &operator=(GeometryRenderer &&geo);
 	void draw() const;
+	// draws only count indexes (or vertexes) starting at first (e.g. a level
+	// of detail), without changing the range that draw() uses
+	void draw(int first, int count) const;
+	// its own per instance model matrixes for drawInstanced (bound to the 
+	// shader's instanceMatrix attribute by Shader::setBuffers(geo,true))
+	void setInstanceMatrixes(const glm::mat4 *matrixes, int count) { instances.update(matrixes,count); }
+	void setInstanceMatrixes(const std::vector<glm::mat4> &matrixes) { instances.update(matrixes); }
+	int instanceCount() const { return instances.count(); }
+	GLuint instancesVBO() const { return instances.getId(); }
+	// draws all the instances with a single call
+	void drawInstanced() const;
+	// same with a range, and the instances given to Shader::setBuffers
+	void drawInstanced(int instance_count, int first, int count) const;
+	// the range that draw() uses; the constructors set the whole buffer
+	void setDrawRange(int first, int count);
+	int drawFirst() const { return first; }
+	int drawCount() const { return count; }
 	GLuint vertexArray() const { return VAO; }
-	GLuint positionsVBO() const { return VBO_pos; }
-	GLuint normalsVBO() const { return VBO_norms; }
-	GLuint texCoordsVBO() const { return VBO_tcs; }
+	GLuint positionsVBO() const { return layout.positions.buffer; }
+	GLuint normalsVBO() const { return layout.normals.buffer; }
+	GLuint texCoordsVBO() const { return layout.tex_coords.buffer; }
+	bool isCompact() const { return format&fCompact; }
+	bool isInterleaved() const { return format&fInterleaved; }
+	bool isStream() const { return format&fStream; }
+	const VertexLayout &vertexLayout() const { return layout; }
+	const VertexDecode &vertexDecode() const { return decode; }
+	std::size_t memorySize() const; // bytes of all its GPU buffers
 	
+	// with fInterleaved these write only their attribute (strided), and 
+	// realloc can not change the vertex count (nor with fStream)
 	void updateTexCoords(const std::vector<glm::vec2> &vtc, bool realloc=false, bool dynamic=false);
 	void updatePositions(const std::vector<glm::vec3> &vp, bool realloc=false, bool dynamic=false);
 	void updateNormals(const std::vector<glm::vec3> &vn, bool realloc=false, bool dynamic=false);
 	void updateElements(const std::vector<int> &ve, bool realloc=false, bool dynamic=false);
+	// partial updates, count vertexes starting at first_vertex (not available
+	// for compact positions and tex_coords, which depend on the bounding box)
+	void updateTexCoords(const glm::vec2 *vtc, int first_vertex, int count);
+	void updatePositions(const glm::vec3 *vp, int first_vertex, int count);
+	void updateNormals(const glm::vec3 *vn, int first_vertex, int count);
 	
 	~GeometryRenderer();
 private:
 	GeometryRenderer(const GeometryRenderer &) = delete;
 	GeometryRenderer &operator=(const GeometryRenderer &) = default;
+	void init(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+			  int vertex_count, const int *triangles, int index_count, bool dynamic, int format);
+	void uploadPositions(const glm::vec3 *positions, int vertex_count, bool realloc, bool dynamic);
+	void uploadNormals(const glm::vec3 *normals, int vertex_count, bool realloc, bool dynamic);
+	void uploadTexCoords(const glm::vec2 *tex_coords, int vertex_count, bool realloc, bool dynamic);
+	void uploadAttrib(int i, const void *data, std::size_t element_size, 
+					  int first_vertex, int vertex_count, bool realloc, bool dynamic);
+	void uploadElements(const int *triangles, int index_count, bool realloc, bool dynamic);
+	void flushStream() const;
+	// the vertex attributes, indexes for attrib, vertexBuffer and stream_data
+	enum Attrib { aPositions=0, aNormals=1, aTexCoords=2, attrib_count=3 };
+	VertexAttrib &attrib(int i);
+	GLuint &vertexBuffer(int i);
 	void freeResources();
-	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0;
-	int count = 0;
+	void drawCall(int first, int count, int instance_count) const; // 0 instances for a non instanced draw
+	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0; // (with fInterleaved, VBO_pos has everything)
+	InstanceBuffer instances;
+	int first = 0, count = 0, vertex_count = 0, index_count = 0;
+	int format = fSeparate;
+	GLenum index_type = GL_UNSIGNED_INT;
+	VertexLayout layout;
+	VertexDecode decode;
+	// fStream: copy in RAM of each buffer, and the copy in the GPU in use
+	static const int stream_slots = 3;
+	std::vector<char> stream_data[attrib_count];
+	mutable bool stream_dirty = false;
+	mutable int stream_slot = 0;
+	mutable GLsync stream_fences[stream_slots] = {}; // signaled when the GPU is done with each copy
 };
 
 #endif
-
@@ -0,0 +1,69 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include "Geometry.hpp"
+#include "Material.hpp"
+#include "MappedFile.hpp"
+#include "MeshSimplifier.hpp"
+
+// Binary cache with the final geometry (after toGeometry, fitting and normals
+// generation) and material of every part of a model, so it can be loaded 
+// without parsing the .obj again. It remembers size and modification time 
+// of its source files (.obj and .mtl), and is discarded if any of them 
+// changed. The file is mapped, and the arrays point directly into it.
+class MeshCache {
+public:
+	struct Part {
+		Material material;
+		const glm::vec3 *positions = nullptr, *normals = nullptr;
+		const glm::vec2 *tex_coords = nullptr; // normals and tex_coords can be null
+		const int *triangles = nullptr;
+		int vertex_count = 0, index_count = 0;
+		std::vector<LodLevel> lods; // empty if it has no levels of detail
+		Geometry toGeometry() const; // copies the arrays
+	};
+	
+	MeshCache() = default;
+	MeshCache(const std::string &cache_path, std::uint32_t key); // isOk()==false if missing or outdated
+	bool isOk() const { return not vparts.empty(); }
+	bool isComplete() const { return complete; } // false if only some of the parts were saved
+	const std::vector<Part> &parts() const { return vparts; }
+	
+private:
+	MappedFile file;
+	std::vector<Part> vparts;
+	bool complete = false;
+};
+
+// Writes a cache file part by part; addPart only keeps references to the
+// part, so it must live until finish(), which writes the whole file with
+// replaceFile (see Misc.hpp): an interrupted write, or two writers for the
+// same cache, never leave a corrupted cache behind
+class MeshCacheWriter {
+public:
+	MeshCacheWriter(const std::string &cache_path, std::uint32_t key, 
+					const std::vector<std::string> &sources, int parts_count, int total_parts_count);
+	void addPart(const Geometry &geo, const Material &mat, const std::vector<LodLevel> &lods = {});
+	bool finish();
+private:
+	MeshCacheWriter(const MeshCacheWriter &) = delete;
+	MeshCacheWriter &operator=(const MeshCacheWriter &) = delete;
+	struct PartRef { const Geometry *geo; const Material *mat; std::vector<LodLevel> lods; };
+	std::string path;
+	std::uint32_t key;
+	std::vector<std::string> sources;
+	int parts_count, total_parts_count;
+	std::vector<PartRef> parts;
+};
+
+// name of the cache file for an .obj (key is included, so caches generated
+// with different settings do not overwrite each other)
+std::string meshCachePath(const std::string &obj_path, std::uint32_t key);
+
+#endif
+
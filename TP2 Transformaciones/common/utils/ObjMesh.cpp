@@ -1,47 +1,73 @@
 #include <fstream>
 #include <map>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <climits>
 #include <glm/glm.hpp>
 #include "ObjMesh.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
-#include <unordered_map>
+#include "MappedFile.hpp"
+#include "FastParse.hpp"
+#include "ThreadPool.hpp"
 
 namespace {
 
-float readInt(const std::string &s, int &i) {
-	char *p = const_cast<char*>(s.c_str())+i;
-	int r = std::strtol(p,&p,10);
-	i = p-s.c_str();
+// helpers for parsing a line in place, given as a [p;eol) range; they never
+// read past eol (mapped files are not null-terminated)
+
+const char *skipBlanks(const char *p, const char *eol) {
+	while (p!=eol and (*p==' ' or *p=='\t')) ++p;
+	return p;
+}
+
+bool startsWith(const char *p, const char *eol, const char *con) {
+	for(;*con;++con,++p) 
+		if (p==eol or *p!=*con) return false;
+	return true;
+}
+using ::startsWith; // std::string version, from Misc.hpp
+
+int readInt(const char *&p, const char *eol) {
+	int r = 0;
+	p = skipBlanks(p,eol);
+	parseInt(p,eol,r);
 	return r;
 }
 
-float readFloat(const std::string &s, int &i) {
-	char *p = const_cast<char*>(s.c_str())+i;
-	float r = std::strtof(p,&p);
-	i = p-s.c_str();
+float readFloat(const char *&p, const char *eol) {
+	float r = 0.f;
+	p = skipBlanks(p,eol);
+	parseFloat(p,eol,r);
 	return r;
 }
 
-float readFloat(const std::string &s, const int &i) {
-	int j = i; return readFloat(s,j);
+float readFloat(const std::string &s, int i) {
+	const char *p = s.data()+i;
+	return readFloat(p,s.data()+s.size());
 }
 
-glm::vec3 readVec3(const std::string &s, int i) {
+glm::vec3 readVec3(const char *p, const char *eol) {
 	glm::vec3 v;
-	v.x = readFloat(s,i); ++i;
-	v.y = readFloat(s,i); ++i;
-	v.z = readFloat(s,i);
+	v.x = readFloat(p,eol);
+	v.y = readFloat(p,eol);
+	v.z = readFloat(p,eol);
 	return v;
 }
 
-glm::vec2 readVec2(const std::string &s, int i) {
+glm::vec2 readVec2(const char *p, const char *eol) {
 	glm::vec2 v;
-	v.x = readFloat(s,i); ++i;
-	v.y = readFloat(s,i);
+	v.x = readFloat(p,eol);
+	v.y = readFloat(p,eol);
 	return v;
 }
 
+glm::vec3 readVec3(const std::string &s, int i) {
+	return readVec3(s.data()+i,s.data()+s.size());
+}
+
 std::map<std::string,Material> loadMaterialsLib(const std::string &path, const std::string &filename) {
 	cg_info( "Reading mtl file: " + path+filename + "...");
 	std::ifstream file(path+filename);
@@ -50,6 +76,7 @@ std::map<std::string,Material> loadMaterialsLib(const std::string &path, const s
 	std::map<std::string,Material> lib;
 	Material *current_material = nullptr;
 	for(std::string line; std::getline(file,line); ) {
+		fixEOL(line);
 		if (line.empty() or line[0]=='#') continue;
 		if (startsWith(line,"newmtl ")) {
 			cg_assert(lib.count(line.substr(7))==0,"Duplicate material name");
@@ -78,81 +105,401 @@ std::map<std::string,Material> loadMaterialsLib(const std::string &path, const s
 	return lib;
 }
 
+ObjMesh::Element readFace(const char *p, const char *eol) {
+	ObjMesh::Element e; 
+	int in = 0;
+	while((p=skipBlanks(p,eol))!=eol) {
+		cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
+		e.pos[in] = readInt(p,eol)-1;
+		if (p!=eol and *p=='/') {
+			if (++p!=eol and *p=='/') {
+				e.tcs[in] = -1;
+				e.norms[in] = readInt(++p,eol)-1;
+			} else {
+				e.tcs[in] = readInt(p,eol)-1;
+				if (p!=eol and *p=='/') {
+					e.norms[in] = readInt(++p,eol)-1;
+				} else {
+					e.norms[in] = -1;
+				}
+			}
+		} else {
+			e.tcs[in] = -1;
+			e.norms[in] = -1;
+		}
+		++in;
+	}
+	cg_assert(in>2,"Face with less than 3 vertexes");
+	if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
+	return e;
 }
 
-ObjMesh readObj(const std::string &full_path) {
-	cg_info( "Reading obj file: " + full_path + "..." );
-	std::string path = extractFolder(full_path);
-	std::ifstream file(full_path);
-	cg_assert(file.is_open(),"Could not open obj file");
-	
+// calls f(line,eol) for every line in [p;end), without the trailing \r\n
+template<typename F>
+void forEachLine(const char *p, const char *end, F &&f) {
+	while (p<end) {
+		const char *eol = static_cast<const char*>(std::memchr(p,'\n',end-p));
+		if (not eol) eol = end;
+		f(p, eol!=p and eol[-1]=='\r' ? eol-1 : eol);
+		p = eol==end ? end : eol+1;
+	}
+}
+
+// state for building an ObjMesh one line at a time
+struct ObjBuilder {
+	std::string path;
 	ObjMesh meshes;
 	ObjMesh::Part *current_part = nullptr;
 	std::map<std::string,Material> materials_lib;
 	std::string current_name;
 	
-	for(std::string line; std::getline(file,line); ) {
-		if (line.empty() or line[0]=='#') continue;
-		if (startsWith(line,"o ")) {
-			meshes.parts.push_back({}); 
-			current_part = &meshes.parts.back();
-			current_name = current_part->name = line.substr(2);
-		} else if (startsWith(line,"mtllib ")) {
-			materials_lib = loadMaterialsLib(path,line.substr(7));
+	ObjBuilder(const std::string &path) : path(path) {}
+	void parseLine(const char *line, const char *eol);
+	
+	// directives that change the current part
+	void newObject(const char *name, const char *name_end);
+	void loadLib(const char *fname, const char *fname_end);
+	void ensurePart();
+	void useMaterial(const char *name, const char *name_end);
+};
+
+void ObjBuilder::parseLine(const char *line, const char *eol) {
+	if (line==eol or line[0]=='#') return;
+	if (startsWith(line,eol,"o ")) {
+		newObject(line+2,eol);
+	} else if (startsWith(line,eol,"mtllib ")) {
+		loadLib(line+7,eol);
+	} else {
+		ensurePart();
+		if (startsWith(line,eol,"v ")) {
+			meshes.positions.push_back(readVec3(line+2,eol));
+		} else if (startsWith(line,eol,"vn ")) {
+			meshes.normals.push_back(readVec3(line+3,eol));
+		} else if (startsWith(line,eol,"vt ")) {
+			meshes.tex_coords.push_back(readVec2(line+3,eol));
+		} else if (startsWith(line,eol,"f ")) {
+			current_part->elements.push_back(readFace(line+2,eol));
+		} else if (startsWith(line,eol,"usemtl ")) {
+			useMaterial(line+7,eol);
+		}
+	}
+}
+
+void ObjBuilder::newObject(const char *name, const char *name_end) {
+	meshes.parts.push_back({}); 
+	current_part = &meshes.parts.back();
+	current_name = current_part->name = std::string(name,name_end);
+}
+
+void ObjBuilder::loadLib(const char *fname, const char *fname_end) {
+	std::string lib_name(fname,fname_end);
+	materials_lib = loadMaterialsLib(path,lib_name);
+	meshes.material_libs.push_back(path+lib_name);
+}
+
+void ObjBuilder::ensurePart() {
+	if (not current_part) {
+		meshes.parts.push_back({});
+		current_part = &meshes.parts.back();
+	}
+}
+
+void ObjBuilder::useMaterial(const char *name, const char *name_end) {
+	if (not current_part->elements.empty()) {
+		meshes.parts.push_back({}); 
+		current_part = &meshes.parts.back();
+	}
+	std::string mtl_name(name,name_end);
+	current_part->name = current_name+":"+mtl_name;
+	if  (mtl_name!="None") {
+		cg_assert(materials_lib.count(mtl_name),"Material not found: "+mtl_name);
+		current_part->material = materials_lib[mtl_name];
+	}
+}
+
+// Parses a line-aligned chunk of the file independently of the others: 
+// vertex data and faces go to local vectors, and the directives that 
+// affect parts are recorded (with the number of faces read before them) to
+// be replayed later in file order by an ObjBuilder. Face indexes in obj 
+// files are absolute, so they do not need to be adjusted when merging.
+struct ObjChunk {
+	enum class Kind { Object, MtlLib, Touch, UseMtl };
+	struct Marker {
+		Kind kind;
+		std::size_t nelems; // faces in this chunk before the directive
+		const char *text, *text_end; // name (points into the mapped file)
+	};
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> tex_coords;
+	std::vector<ObjMesh::Element> elements;
+	std::vector<Marker> markers;
+	bool touched = false; // Touch stands for "any line that requires a part"
+	
+	void parseLine(const char *line, const char *eol);
+	void replay(ObjBuilder &builder) const;
+};
+
+void ObjChunk::parseLine(const char *line, const char *eol) {
+	if (line==eol or line[0]=='#') return;
+	if (startsWith(line,eol,"o ")) {
+		markers.push_back({Kind::Object,elements.size(),line+2,eol});
+	} else if (startsWith(line,eol,"mtllib ")) {
+		markers.push_back({Kind::MtlLib,elements.size(),line+7,eol});
+	} else {
+		if (not touched) { // only the first one matters, later ones are no-ops
+			markers.push_back({Kind::Touch,elements.size(),nullptr,nullptr});
+			touched = true;
+		}
+		if (startsWith(line,eol,"v ")) {
+			positions.push_back(readVec3(line+2,eol));
+		} else if (startsWith(line,eol,"vn ")) {
+			normals.push_back(readVec3(line+3,eol));
+		} else if (startsWith(line,eol,"vt ")) {
+			tex_coords.push_back(readVec2(line+3,eol));
+		} else if (startsWith(line,eol,"f ")) {
+			elements.push_back(readFace(line+2,eol));
+		} else if (startsWith(line,eol,"usemtl ")) {
+			markers.push_back({Kind::UseMtl,elements.size(),line+7,eol});
+		}
+	}
+}
+
+void ObjChunk::replay(ObjBuilder &builder) const {
+	std::size_t ie = 0;
+	auto flushElements = [&](std::size_t up_to) {
+		if (up_to==ie) return;
+		auto &v = builder.current_part->elements;
+		v.insert(v.end(),elements.begin()+ie,elements.begin()+up_to);
+		ie = up_to;
+	};
+	for(const Marker &m : markers) {
+		flushElements(m.nelems);
+		switch(m.kind) {
+		case Kind::Object: builder.newObject(m.text,m.text_end); break;
+		case Kind::MtlLib: builder.loadLib(m.text,m.text_end); break;
+		case Kind::Touch: builder.ensurePart(); break;
+		case Kind::UseMtl: builder.useMaterial(m.text,m.text_end); break;
+		}
+	}
+	flushElements(elements.size());
+}
+
+template<typename T>
+void concatInParallel(std::vector<T> &dst, const std::vector<ObjChunk> &chunks, 
+					  std::vector<T> ObjChunk::*member) 
+{
+	// prefix sums give the position of each chunk's data in dst
+	std::vector<std::size_t> offsets(chunks.size()+1,0);
+	for(std::size_t i=0;i<chunks.size();++i) 
+		offsets[i+1] = offsets[i] + (chunks[i].*member).size();
+	dst.resize(offsets.back());
+	ThreadPool::shared().parallelFor(chunks.size(),[&](int i) {
+		const std::vector<T> &src = chunks[i].*member;
+		std::copy(src.begin(),src.end(),dst.begin()+offsets[i]);
+	});
+}
+
+void parseInParallel(ObjBuilder &builder, const char *begin, const char *end) {
+	// split the file in line-aligned chunks (more chunks than threads, so
+	// uneven chunks still balance)
+	const std::size_t min_chunk = 1<<20;
+	std::size_t size = end-begin;
+	int nthreads = ThreadPool::shared().size();
+	int nchunks = nthreads<2 ? 1 : static_cast<int>(std::min<std::size_t>(nthreads*4, size/min_chunk));
+	if (nchunks<=1) {
+		forEachLine(begin,end,[&](const char *line, const char *eol) { builder.parseLine(line,eol); });
+		return;
+	}
+	std::vector<const char*> limits(nchunks+1);
+	limits[0] = begin; limits[nchunks] = end;
+	for(int i=1;i<nchunks;++i) {
+		const char *p = std::max(limits[i-1], begin+size*i/nchunks);
+		const char *eol = static_cast<const char*>(std::memchr(p,'\n',end-p));
+		limits[i] = eol ? eol+1 : end;
+	}
+	
+	std::vector<ObjChunk> chunks(nchunks);
+	ThreadPool::shared().parallelFor(nchunks,[&](int i) {
+		ObjChunk &chunk = chunks[i];
+		forEachLine(limits[i],limits[i+1],[&](const char *line, const char *eol) { chunk.parseLine(line,eol); });
+	});
+	
+	concatInParallel(builder.meshes.positions,chunks,&ObjChunk::positions);
+	concatInParallel(builder.meshes.normals,chunks,&ObjChunk::normals);
+	concatInParallel(builder.meshes.tex_coords,chunks,&ObjChunk::tex_coords);
+	for(const ObjChunk &chunk : chunks) 
+		chunk.replay(builder);
+}
+
+}
+
+ObjMesh readObj(const std::string &full_path, ObjReadMode mode) {
+	cg_info( "Reading obj file: " + full_path + "..." );
+	auto t0 = std::chrono::steady_clock::now();
+	ObjBuilder builder(extractFolder(full_path));
+	std::size_t bytes = 0;
+	
+	if (mode==ObjReadMode::Stream) {
+		std::ifstream file(full_path);
+		cg_assert(file.is_open(),"Could not open obj file");
+		for(std::string line; std::getline(file,line); ) {
+			bytes += line.size()+1;
+			fixEOL(line);
+			builder.parseLine(line.data(), line.data()+line.size());
+		}
+	} else {
+		MappedFile file(full_path);
+		cg_assert(file.isOk(),"Could not open obj file");
+		if (mode==ObjReadMode::Parallel)
+			parseInParallel(builder,file.begin(),file.end());
+		else
+			forEachLine(file.begin(),file.end(),[&](const char *line, const char *eol) { builder.parseLine(line,eol); });
+		bytes = file.size();
+	}
+	
+	cg_assert(not builder.meshes.parts.empty(),"No mesh object found in file");
+	
+	double ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count();
+	cg_info( "  " + std::to_string(bytes/1048576.0) + " MB in " + std::to_string(ms) + " ms (" 
+			 + std::to_string(bytes/1048576.0/(ms/1000.0)) + " MB/s)" );
+	
+	return std::move(builder.meshes);
+}
+
+ObjIndex::ObjIndex(const std::string &full_path) : path(extractFolder(full_path)), fname(full_path), file(full_path) {
+	cg_info( "Indexing obj file: " + full_path + "..." );
+	cg_assert(file.isOk(),"Could not open obj file");
+	
+	// same rules as ObjBuilder for splitting parts, but only recording 
+	// where things are; ranges are extended while lines are contiguous
+	auto addFaces = [](std::vector<Range> &v, const char *line, const char *next) {
+		if (not v.empty() and v.back().end==line) v.back().end = next;
+		else v.push_back({line,next});
+	};
+	auto addVertex = [](std::vector<Run> &v, const char *line, const char *next) {
+		if (not v.empty() and v.back().end==line) { v.back().end = next; ++v.back().count; }
+		else v.push_back({line,next,v.empty()?0:v.back().first+v.back().count,1});
+	};
+	std::string current_name, current_lib;
+	int icur = -1;
+	const char *p = file.begin(), *end = file.end();
+	while (p<end) {
+		const char *nl = static_cast<const char*>(std::memchr(p,'\n',end-p));
+		const char *line = p, *eol = nl ? nl : end;
+		p = nl ? nl+1 : end;
+		if (eol!=line and eol[-1]=='\r') --eol;
+		if (line==eol or line[0]=='#') continue;
+		if (startsWith(line,eol,"o ")) {
+			parts.push_back({}); icur = parts.size()-1;
+			current_name = parts[icur].name = std::string(line+2,eol);
+		} else if (startsWith(line,eol,"mtllib ")) {
+			current_lib = std::string(line+7,eol);
 		} else {
-			if (not current_part) {
-				meshes.parts.push_back({});
-				current_part = &meshes.parts.back();
-			}
-			if (startsWith(line,"v ")) {
-				meshes.positions.push_back(readVec3(line,2));
-			} else if (startsWith(line,"vn ")) {
-				meshes.normals.push_back(readVec3(line,3));
-			} else if (startsWith(line,"vt ")) {
-				meshes.tex_coords.push_back(readVec2(line,3));
-			} else if (startsWith(line,"f ")) {
-				ObjMesh::Element e; 
-				int is = 2, in = 0, l = line.size();
-				while(is<l) {
-					cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
-					e.pos[in] = readInt(line,is)-1;
-					if (line[is]=='/') {
-						if (line[++is]=='/') {
-							e.tcs[in] = -1;
-							e.norms[in] = readInt(line,++is)-1;
-						} else {
-							e.tcs[in] = readInt(line,is)-1;
-							if (line[is]=='/') {
-								e.norms[in] = readInt(line,++is)-1;
-							} else {
-								e.norms[in] = -1;
-							}
-						}
-					} else {
-						e.tcs[in] = -1;
-						e.norms[in] = -1;
-					}
-					++in;
-				}
-				cg_assert(in>2,"Face with less than 3 vertexes");
-				if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
-				current_part->elements.push_back(e);
-			} else if (startsWith(line,"usemtl ")) {
-				if (not current_part->elements.empty()) {
-					meshes.parts.push_back({}); 
-					current_part = &meshes.parts.back();
-				}
-				current_part->name = current_name+":"+line.substr(7);
-				if  (line.substr(7)!="None") {
-					cg_assert(materials_lib.count(line.substr(7)),"Material not found");
-					current_part->material = materials_lib[line.substr(7)];
+			if (icur==-1) { parts.push_back({}); icur = 0; }
+			if (startsWith(line,eol,"v ")) {
+				addVertex(positions,line,p);
+			} else if (startsWith(line,eol,"vn ")) {
+				addVertex(normals,line,p);
+			} else if (startsWith(line,eol,"vt ")) {
+				addVertex(tex_coords,line,p);
+			} else if (startsWith(line,eol,"f ")) {
+				addFaces(parts[icur].faces,line,p);
+			} else if (startsWith(line,eol,"usemtl ")) {
+				if (not parts[icur].faces.empty()) { parts.push_back({}); icur = parts.size()-1; }
+				std::string mtl_name(line+7,eol);
+				parts[icur].name = current_name+":"+mtl_name;
+				if (mtl_name!="None") {
+					parts[icur].material = mtl_name;
+					parts[icur].material_lib = current_lib;
 				}
 			}
 		}
 	}
-	cg_assert(not meshes.parts.empty(),"No mesh object found in file");
 	
-	return meshes;
+	cg_assert(not parts.empty(),"No mesh object found in file");
+}
+
+int ObjIndex::findPart(const std::string &name) const {
+	for(std::size_t i=0;i<parts.size();++i) 
+		if (parts[i].name==name) return i;
+	return -1;
+}
+
+namespace {
+	
+// appends the vertex data with indexes in [lo;hi] from a list of runs
+template<typename Runs, typename T>
+void readRuns(const Runs &runs, int lo, int hi, int skip, std::vector<T> &out, T (*read)(const char*, const char*)) {
+	if (hi<lo) return;
+	out.reserve(hi-lo+1);
+	for(const auto &run : runs) {
+		if (run.first+run.count<=lo) continue;
+		if (run.first>hi) break;
+		int i = run.first;
+		forEachLine(run.begin,run.end,[&](const char *line, const char *eol) {
+			if (i>=lo and i<=hi) out.push_back(read(line+skip,eol));
+			++i;
+		});
+	}
+	cg_assert(out.size()==std::size_t(hi-lo+1),"Vertex index out of range");
+}
+
+}
+
+ObjMesh ObjIndex::readPart(int ipart) const {
+	cg_assert(ipart>=0 and ipart<partsCount(),"Invalid part index");
+	const PartInfo &info = parts[ipart];
+	ObjMesh mesh;
+	mesh.parts.resize(1);
+	ObjMesh::Part &part = mesh.parts[0];
+	part.name = info.name;
+	for(const Range &r : info.faces) 
+		forEachLine(r.begin,r.end,[&](const char *line, const char *eol) {
+			part.elements.push_back(readFace(line+2,eol));
+		});
+	
+	// only the range of vertex data used by this part is read
+	int lo[3] = {INT_MAX,INT_MAX,INT_MAX}, hi[3] = {-1,-1,-1};
+	auto update = [&](int k, int index) {
+		if (index==-1) return;
+		lo[k] = std::min(lo[k],index); hi[k] = std::max(hi[k],index);
+	};
+	for(const ObjMesh::Element &e : part.elements) {
+		for(int j=0;j<(e.pos[3]==-1?3:4);++j) {
+			update(0,e.pos[j]); update(1,e.norms[j]); update(2,e.tcs[j]);
+		}
+	}
+	readRuns(positions,lo[0],hi[0],2,mesh.positions,readVec3);
+	readRuns(normals,lo[1],hi[1],3,mesh.normals,readVec3);
+	readRuns(tex_coords,lo[2],hi[2],3,mesh.tex_coords,readVec2);
+	for(ObjMesh::Element &e : part.elements) {
+		for(int j=0;j<(e.pos[3]==-1?3:4);++j) {
+			e.pos[j] -= lo[0];
+			if (e.norms[j]!=-1) e.norms[j] -= lo[1];
+			if (e.tcs[j]!=-1) e.tcs[j] -= lo[2];
+		}
+	}
+	
+	if (not info.material.empty()) {
+		cg_assert(not info.material_lib.empty(),"Material not found: "+info.material);
+		auto lib = loadMaterialsLib(path,info.material_lib);
+		cg_assert(lib.count(info.material),"Material not found: "+info.material);
+		part.material = lib[info.material];
+		mesh.material_libs.push_back(path+info.material_lib);
+	}
+	return mesh;
+}
+
+ObjMesh ObjIndex::readPart(const std::string &name) const {
+	int ipart = findPart(name);
+	cg_assert(ipart!=-1,"Part name not found");
+	return readPart(ipart);
+}
+
+std::pair<glm::vec3,glm::vec3> ObjIndex::boundingBox() const {
+	std::vector<glm::vec3> v;
+	readRuns(positions,0,positionsCount()-1,2,v,readVec3);
+	return getBoundingBox(v);
 }
 
 //Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
@@ -170,30 +517,92 @@ ObjMesh readObj(const std::string &full_path) {
 //	return g;
 //}
 
-namespace std {
+namespace {
 	
-	template <> struct hash<std::tuple<int,int,int>> {
-		std::size_t operator()(const std::tuple<int,int,int>& p) const {
-			return ( ( hash<int>()(std::get<0>(p))
-		               ^ (hash<int>()(std::get<1>(p)) << 1) ) >> 1)
-				   ^ (hash<int>()(std::get<0>(p)) << 1);
+// key for a (pos,norm,tc) triple; indexes are stored +1 so -1 (missing) 
+// becomes 0 and a key of all zeros can mark empty slots
+struct WideVertexKey {
+	std::uint64_t pos_norm = 0, tc = 0;
+	bool operator==(const WideVertexKey &o) const { return pos_norm==o.pos_norm and tc==o.tc; }
+};
+
+inline std::uint64_t mixHash(std::uint64_t k) {
+	k ^= k>>33; k *= 0xff51afd7ed558ccdULL;
+	k ^= k>>33; k *= 0xc4ceb9fe1a85ec53ULL;
+	return k^(k>>33);
+}
+// every bit of the key must be mixed: a hash that keeps the position index
+// apart puts all the (norm,tc) variants of a position in neighbouring slots,
+// and with linear probing they become long clusters (flat shaded meshes 
+// have a variant per face)
+inline std::uint64_t hashKey(std::uint64_t k) { return mixHash(k); }
+inline std::uint64_t hashKey(const WideVertexKey &k) { return mixHash(k.pos_norm^mixHash(k.tc)); }
+inline bool isEmptyKey(std::uint64_t k) { return k==0; }
+inline bool isEmptyKey(const WideVertexKey &k) { return k.pos_norm==0; }
+
+// open addressing (linear probing) table from vertex keys to indexes
+// in the resulting Geometry; keys and values are kept in separate arrays
+// so the probing only touches the keys
+template<typename Key>
+class VertexTable {
+public:
+	VertexTable(std::size_t expected) {
+		std::size_t cap = 16;
+		while (cap<expected*2) cap *= 2;
+		keys.resize(cap); values.resize(cap);
+	}
+	// returns the index for the key, inserting new_value if not there
+	int insert(const Key &key, int new_value) {
+		std::size_t mask = keys.size()-1, i = hashKey(key)&mask;
+		while (not isEmptyKey(keys[i])) {
+			if (keys[i]==key) return values[i];
+			i = (i+1)&mask;
 		}
-	};
-	
+		keys[i] = key; values[i] = new_value;
+		if (++count*2>keys.size()) grow();
+		return new_value;
+	}
+private:
+	void grow() {
+		std::vector<Key> old_keys; old_keys.swap(keys);
+		std::vector<int> old_values; old_values.swap(values);
+		keys.resize(old_keys.size()*2); values.resize(old_values.size()*2);
+		std::size_t mask = keys.size()-1;
+		for(std::size_t j=0;j<old_keys.size();++j) { 
+			if (isEmptyKey(old_keys[j])) continue;
+			std::size_t i = hashKey(old_keys[j])&mask;
+			while (not isEmptyKey(keys[i])) i = (i+1)&mask;
+			keys[i] = old_keys[j]; values[i] = old_values[j];
+		}
+	}
+	std::vector<Key> keys;
+	std::vector<int> values;
+	std::size_t count = 0;
+};
+
+int bitsFor(std::size_t n) { // bits needed to store values in [0;n]
+	int b = 0; 
+	while (n>>b) ++b;
+	return b;
 }
 
-Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+template<typename Key, typename MakeKey>
+Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part, MakeKey make_key) {
 	Geometry g;
-	std::unordered_map<std::tuple<int,int,int>,int> map;
-	auto addVertex = [&g,&obj,&map](const ObjMesh::Element &e, int inode) {
-		auto t = std::make_tuple(e.pos[inode],e.norms[inode],e.tcs[inode]);
-		auto p = map.insert({t,g.positions.size()});
-		if (p.second) {
+	std::size_t corners = 0;
+	for(const ObjMesh::Element &e : part.elements) 
+		corners += e.pos[3]==-1 ? 3 : 4;
+	VertexTable<Key> table(std::min(corners,std::max({obj.positions.size(),obj.normals.size(),obj.tex_coords.size()})));
+	g.triangles.reserve(part.elements.size()*3);
+	auto addVertex = [&g,&obj,&table,&make_key](const ObjMesh::Element &e, int inode) {
+		int index = table.insert(make_key(e.pos[inode]+1,e.norms[inode]+1,e.tcs[inode]+1),
+								 static_cast<int>(g.positions.size()));
+		if (index==static_cast<int>(g.positions.size())) {
 			g.positions.push_back(obj.positions[e.pos[inode]]);
 			if (e.norms[inode]!=-1) g.normals.push_back(obj.normals[e.norms[inode]]);
 			if (e.tcs[inode]!=-1) g.tex_coords.push_back(obj.tex_coords[e.tcs[inode]]);
 		}
-		g.triangles.push_back(p.first->second);
+		g.triangles.push_back(index);
 	};
 	for(const ObjMesh::Element &e : part.elements) {
 		addVertex(e,0); addVertex(e,1); addVertex(e,2);
@@ -202,6 +611,24 @@ Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
 	}
 	return g;
 }
+	
+}
+
+Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+	// pack the triple in a single 64 bits key if it fits (it almost always 
+	// does), with just as many bits per index as needed for this obj
+	int norm_bits = bitsFor(obj.normals.size()), tc_bits = bitsFor(obj.tex_coords.size());
+	if (bitsFor(obj.positions.size())+norm_bits+tc_bits<=64) {
+		return toGeometry<std::uint64_t>(obj,part,[norm_bits,tc_bits](std::uint64_t p, std::uint64_t n, std::uint64_t t) {
+			return (((p<<norm_bits)|n)<<tc_bits)|t;
+		});
+	} else {
+		return toGeometry<WideVertexKey>(obj,part,[](std::uint64_t p, std::uint64_t n, std::uint64_t t) {
+			WideVertexKey k; k.pos_norm = (p<<32)|n; k.tc = t;
+			return k;
+		});
+	}
+}
 
 Geometry toGeometry(const ObjMesh &obj, int ipart) {
 	return toGeometry(obj,obj.parts[ipart]);
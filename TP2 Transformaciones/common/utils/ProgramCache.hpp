@@ -0,0 +1,36 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+// Binary cache of linked shader programs (GL_ARB_get_program_binary), so a
+// program can be created without compiling nor linking its shaders again.
+// The key is a hash of the preprocessed sources and the driver strings
+// (vendor, renderer and version), so the cache is discarded if any shader
+// (or any of its #includes) changes, or if the driver is updated. Drivers
+// may still reject a binary (then loadProgramBinary returns false and the
+// program must be built from the sources).
+
+// false if the driver does not support it (or it supports no binary format)
+bool programBinarySupported();
+
+std::uint64_t programCacheKey(const std::string &vertex_source, const std::string &fragment_source);
+
+// name of the cache file for a vertex/fragment pair (next to the vertex shader)
+std::string programCachePath(const std::string &vertex_fname, const std::string &fragment_fname);
+
+// program must be a new one (from glCreateProgram); returns true if it is
+// now linked, otherwise it should be deleted and created again
+bool loadProgramBinary(GLuint program, const std::string &cache_path, std::uint64_t key);
+
+// call before linking, so the driver keeps the binary for saveProgramBinary
+void prepareProgramBinary(GLuint program);
+
+// program must be linked; the file is written with a temporary name and
+// then renamed, so an interrupted write never leaves a corrupted cache
+bool saveProgramBinary(GLuint program, const std::string &cache_path, std::uint64_t key);
+
+#endif
+
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include "RenderQueue.hpp"
+
+static bool sameValues(const Material &a, const Material &b) {
+	return a.ka==b.ka and a.kd==b.kd and a.ks==b.ks and a.ke==b.ke
+		and a.shininess==b.shininess and a.opacity==b.opacity;
+}
+
+void RenderQueue::setCamera(const glm::mat4 &view, const glm::mat4 &projection) {
+	view_matrix = view; projection_matrix = projection;
+}
+
+void RenderQueue::setLight(const glm::vec4 &position, const glm::vec3 &color, float ambient_strength) {
+	light_position = position; light_color = color; this->ambient_strength = ambient_strength;
+}
+
+int RenderQueue::materialId(const Material &material) {
+	// parts usually share a few materials, so a linear search is enough
+	for(size_t i=0;i<materials.size();++i) 
+		if (materials[i]==&material or sameValues(*materials[i],material)) 
+			return i;
+	materials.push_back(&material);
+	return materials.size()-1;
+}
+
+void RenderQueue::add(Shader &shader, const GeometryRenderer &buffers, const Material &material, 
+					  const Texture *texture, const glm::mat4 &model_matrix, 
+					  const UniformBuffer *material_buffer) 
+{
+	if (texture and not texture->isOk()) texture = nullptr;
+	if (material_buffer and not material_buffer->isOk()) material_buffer = nullptr;
+	items.push_back({&shader,&buffers,buffers.drawFirst(),buffers.drawCount(),&material,material_buffer,texture,nullptr,texture?texture->getId():0,0,
+					 materialId(material),model_matrix,material.opacity<1.f});
+}
+
+void RenderQueue::add(Shader &shader, const Model &model, const glm::mat4 &model_matrix) {
+	add(shader,*model.buffers,model.material,model.texture.get(),model_matrix,&model.material_buffer);
+	Item &item = items.back();
+	item.first = model.drawFirst(); // its own level of detail
+	item.count = model.drawCount();
+	if (model.texture_array and model.texture_array->isOk()) {
+		item.texture_array = model.texture_array.get();
+		item.texture_id = item.texture_array->getId();
+		item.texture_layer = model.texture_layer;
+	}
+}
+
+void RenderQueue::flush() {
+	order.resize(items.size());
+	for(size_t i=0;i<items.size();++i) order[i] = &items[i];
+	std::stable_sort(order.begin(),order.end(),[](const Item *a, const Item *b) {
+		if (a->transparent or b->transparent) return b->transparent and not a->transparent;
+		GLuint pa = a->shader->getProgramId(), pb = b->shader->getProgramId();
+		if (pa!=pb) return pa<pb;
+		if (a->texture_id!=b->texture_id) return a->texture_id<b->texture_id;
+		if (a->material_id!=b->material_id) return a->material_id<b->material_id;
+		if (a->texture_layer!=b->texture_layer) return a->texture_layer<b->texture_layer;
+		return a->buffers<b->buffers;
+	});
+	
+	Stats st; st.items = items.size();
+	int naive = 0; // changes that setting everything for every item would issue
+	const Item *prev = nullptr; GLuint bound_texture = 0;
+	for(const Item *it : order) {
+		Shader &shader = *it->shader;
+		naive += 5 + (it->texture_id ? 1 : 0); // program, camera, light, material, buffers (and texture)
+		// uniforms and attribute locations belong to the program, so 
+		// everything but the texture must be sent again after a switch
+		bool new_program = not prev or prev->shader->getProgramId()!=shader.getProgramId();
+		if (new_program) {
+			shader.use();
+			shader.setUniform("viewMatrix",view_matrix);
+			shader.setUniform("projectionMatrix",projection_matrix);
+			shader.setLight(light_position,light_color,ambient_strength);
+			++st.programs;
+		}
+		if (it->texture_id and it->texture_id!=bound_texture) {
+			if (it->texture) it->texture->bind();
+			else it->texture_array->bind();
+			bound_texture = it->texture_id; ++st.textures;
+		}
+		if (new_program or prev->material_id!=it->material_id or prev->texture_layer!=it->texture_layer) {
+			shader.setMaterial(*it->material);
+			if (it->material_buffer) it->material_buffer->bind(ubMaterial);
+			++st.materials;
+		}
+		if (new_program or prev->buffers!=it->buffers) {
+			shader.setBuffers(*it->buffers);
+			++st.buffers;
+		}
+		shader.setModelMatrix(it->model_matrix,view_matrix);
+		it->buffers->draw(it->first,it->count);
+		prev = it;
+	}
+	st.saved = naive - (3*st.programs + st.textures + st.materials + st.buffers);
+	last_stats = st;
+	items.clear(); materials.clear();
+}
+
@@ -1,11 +1,16 @@
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <iostream>
 #include <glad/glad.h>
+#include <glm/matrix.hpp>
 #include "Shaders.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
+#include "UniformBlocks.hpp"
+#include "ProgramCache.hpp"
 
 static std::string getShaderSource(std::string file_path) {
 	std::ifstream fs(file_path,std::ios::binary);
@@ -28,16 +33,20 @@ static std::string getShaderSource(std::string file_path) {
 	return full_content;
 }
 
-static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
+// only submits the source, see checkShader
+static GLuint compileShader(GLenum shader_type, const std::string &shader_code, const std::string &file_path) {
 	GLuint shader_id = glCreateShader(shader_type);
 	
-	std::string shader_code = getShaderSource(file_path);
-	
 	cg_info("Compiling shader: " + file_path + "...");
 	const char *shader_code_ptr = shader_code.c_str();
 	glShaderSource(shader_id,1,&shader_code_ptr,nullptr);
 	glCompileShader(shader_id);
 	
+	return shader_id;
+}
+
+// waits for the compilation to end
+static void checkShader(GLuint shader_id, const std::string &file_path) {
 	GLint result = GL_FALSE, log_len = 0;
 	glGetShaderiv(shader_id,GL_COMPILE_STATUS,&result);
 	glGetShaderiv(shader_id,GL_INFO_LOG_LENGTH,&log_len);
@@ -47,8 +56,6 @@ static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
 		std::cerr << log.data() << std::endl;
 	}
 	cg_assert(result==GL_TRUE,"Failed to compile shader "+std::string(file_path));
-	
-	return shader_id;
 }
 
 Shader::Shader (const std::string &vertex_fname, const std::string &fragment_fname) {
@@ -71,41 +78,191 @@ Shader &Shader::operator=(Shader &&other) {
 }
 
 void Shader::load(const std::string &vertex_fname, const std::string &fragment_fname) {
+	loadDeferred(vertex_fname,fragment_fname);
+	finishLoad();
+}
+
+void Shader::loadDeferred(const std::string &vertex_fname, const std::string &fragment_fname) {
 	cg_assert(program_id==0,"Shader already loaded");
-	GLuint vertex_id = loadAndCompile(GL_VERTEX_SHADER,vertex_fname);
-	GLuint fragment_id = loadAndCompile(GL_FRAGMENT_SHADER,fragment_fname);
+	static bool threads_set = false;
+	if (GLAD_GL_KHR_parallel_shader_compile and not threads_set) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many as the driver wants
+		threads_set = true;
+	}
+	
+	pending = PendingLoad();
+	pending.vertex_fname = vertex_fname; pending.fragment_fname = fragment_fname;
+	pending.loading = true;
+	std::string vertex_code = getShaderSource(vertex_fname);
+	std::string fragment_code = getShaderSource(fragment_fname);
+	
+	// a cached binary skips compiling and linking (see ProgramCache.hpp)
+	pending.cache_path = programCachePath(vertex_fname,fragment_fname);
+	pending.cache_key = programCacheKey(vertex_code,fragment_code);
+	program_id = glCreateProgram();
+	if (loadProgramBinary(program_id,pending.cache_path,pending.cache_key)) {
+		cg_info("Loaded shader program: " + pending.cache_path);
+		return;
+	}
+	glDeleteProgram(program_id); // a rejected binary may leave it unusable
+	
+	pending.vertex_id = compileShader(GL_VERTEX_SHADER,vertex_code,vertex_fname);
+	pending.fragment_id = compileShader(GL_FRAGMENT_SHADER,fragment_code,fragment_fname);
 	
 	cg_info( "Linking shader program..." );
 	program_id = glCreateProgram();
-	glAttachShader(program_id,vertex_id);
-	glAttachShader(program_id,fragment_id);
+	glAttachShader(program_id,pending.vertex_id);
+	glAttachShader(program_id,pending.fragment_id);
+	prepareProgramBinary(program_id);
 	glLinkProgram(program_id);
+}
+
+bool Shader::isReady() const {
+	if (not pending.loading or not GLAD_GL_KHR_parallel_shader_compile) return true;
+	GLint done = GL_TRUE;
+	glGetProgramiv(program_id,GL_COMPLETION_STATUS_KHR,&done);
+	return done==GL_TRUE;
+}
+
+void Shader::finishLoad() {
+	if (not pending.loading) return;
+	pending.loading = false;
 	
-	GLint result = GL_FALSE, log_len = 0;
-	glGetProgramiv(program_id,GL_LINK_STATUS,&result);
-	glGetProgramiv(program_id,GL_INFO_LOG_LENGTH,&log_len);
-	if (log_len) {
-		std::vector<char> log(log_len);
-		glGetProgramInfoLog(program_id,log_len,nullptr,log.data());
-		std::cerr << log.data() << std::endl;
+	if (pending.vertex_id!=0) { // not from the cache
+		checkShader(pending.vertex_id,pending.vertex_fname);
+		checkShader(pending.fragment_id,pending.fragment_fname);
+		
+		GLint result = GL_FALSE, log_len = 0;
+		glGetProgramiv(program_id,GL_LINK_STATUS,&result);
+		glGetProgramiv(program_id,GL_INFO_LOG_LENGTH,&log_len);
+		if (log_len) {
+			std::vector<char> log(log_len);
+			glGetProgramInfoLog(program_id,log_len,nullptr,log.data());
+			std::cerr << log.data() << std::endl;
+		}
+		cg_assert(result==GL_TRUE,"Failed to link shader program");
+		
+		glDetachShader(program_id,pending.vertex_id);
+		glDetachShader(program_id,pending.fragment_id);
+		
+		glDeleteShader(pending.vertex_id);
+		glDeleteShader(pending.fragment_id);
+		
+		saveProgramBinary(program_id,pending.cache_path,pending.cache_key);
 	}
-	cg_assert(result==GL_TRUE,"Failed to link shader program");
+	pending = PendingLoad();
+	
+	reflect();
+}
+
+void Shader::reflect() {
+	uniforms.clear(); attribs.clear(); common = {};
+	GLint count = 0, max_uniform_len = 0, max_attrib_len = 0;
+	glGetProgramiv(program_id,GL_ACTIVE_UNIFORM_MAX_LENGTH,&max_uniform_len);
+	glGetProgramiv(program_id,GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,&max_attrib_len);
+	std::vector<char> name(std::max(max_uniform_len,max_attrib_len)+1,'\0');
 	
-	glDetachShader(program_id,vertex_id);
-	glDetachShader(program_id,fragment_id);
+	glGetProgramiv(program_id,GL_ACTIVE_UNIFORMS,&count);
+	for(int i=0;i<count;++i) {
+		GLint size = 0; GLenum type;
+		glGetActiveUniform(program_id,i,name.size(),nullptr,&size,&type,name.data());
+		std::string base = name.data();
+		if (base.size()>3 and base.compare(base.size()-3,3,"[0]")==0) base.erase(base.size()-3);
+		for(int j=0;j<size;++j) {
+			std::string elem = j==0 ? base : base+"["+std::to_string(j)+"]";
+			GLint loc = glGetUniformLocation(program_id,elem.c_str());
+			if (loc==-1) continue; // in a uniform block
+			UniformSlot u; u.name = elem; u.location = loc;
+			uniforms.push_back(u);
+		}
+	}
+	std::sort(uniforms.begin(),uniforms.end(),[](const UniformSlot &a, const UniformSlot &b) { return a.name<b.name; });
 	
-	glDeleteShader(vertex_id);
-	glDeleteShader(fragment_id);
+	glGetProgramiv(program_id,GL_ACTIVE_ATTRIBUTES,&count);
+	for(int i=0;i<count;++i) {
+		GLint size = 0; GLenum type;
+		glGetActiveAttrib(program_id,i,name.size(),nullptr,&size,&type,name.data());
+		GLint loc = glGetAttribLocation(program_id,name.data());
+		if (loc!=-1) attribs.emplace_back(name.data(),loc); // (-1 for built-ins like gl_VertexID)
+	}
+	std::sort(attribs.begin(),attribs.end());
+	
+	bindUniformBlocks(program_id);
+	
+	common.model = getUniform<glm::mat4>("modelMatrix");
+	common.view = getUniform<glm::mat4>("viewMatrix");
+	common.projection = getUniform<glm::mat4>("projectionMatrix");
+	common.normal_matrix = getUniform<glm::mat3>("normalMatrix");
+	common.light_position = getUniform<glm::vec4>("lightPosition");
+	common.light_color = getUniform<glm::vec3>("lightColor");
+	common.ambient_strength = getUniform<float>("ambientStrength");
+	common.diffuse = getUniform<glm::vec3>("diffuseColor");
+	common.specular = getUniform<glm::vec3>("specularColor");
+	common.ambient = getUniform<glm::vec3>("ambientColor");
+	common.emission = getUniform<glm::vec3>("emissionColor");
+	common.opacity = getUniform<float>("opacity");
+	common.shininess = getUniform<float>("shininess");
+	common.position_scale = getUniform<glm::vec3>("vertexPositionScale");
+	common.position_offset = getUniform<glm::vec3>("vertexPositionOffset");
+	common.tex_coords_scale = getUniform<glm::vec2>("vertexTexCoordsScale");
+	common.tex_coords_offset = getUniform<glm::vec2>("vertexTexCoordsOffset");
+	common.octahedral_normals = getUniform<int>("vertexNormalOctahedral");
+	common.position = getAttribLocation("vertexPosition");
+	common.normal = getAttribLocation("vertexNormal");
+	common.tex_coords = getAttribLocation("vertexTexCoords");
+	common.instance_matrix = getAttribLocation("instanceMatrix");
+}
+
+// binary search by name, without building a std::string
+template<typename V, typename F> 
+static int findByName(const V &v, const char *name, size_t len, F get_name) {
+	auto it = std::lower_bound(v.begin(),v.end(),name,[&](const typename V::value_type &e, const char *) { 
+		return get_name(e).compare(0,std::string::npos,name,len)<0; 
+	});
+	if (it==v.end() or get_name(*it).compare(0,std::string::npos,name,len)!=0) return -1;
+	return it-v.begin();
+}
+
+int Shader::findUniform(const char *name) const {
+	auto get_name = [](const UniformSlot &u) -> const std::string& { return u.name; };
+	size_t len = std::strlen(name);
+	int i = findByName(uniforms,name,len,get_name);
+	if (i==-1 and len>3 and std::strcmp(name+len-3,"[0]")==0) // name[0] is stored as name
+		i = findByName(uniforms,name,len-3,get_name);
+	return i;
+}
+
+GLint Shader::getAttribLocation(const char *name) {
+	finishLoad();
+	int i = findByName(attribs,name,std::strlen(name),[](const std::pair<std::string,GLint> &a) -> const std::string& { return a.first; });
+	return i==-1 ? -1 : attribs[i].second;
+}
+
+// true if that value was the last one uploaded (so the upload can be
+// skipped), otherwise remembers it
+bool Shader::isUploaded(int slot, const void *value, int bytes) {
+	UniformSlot &u = uniforms[slot];
+	if (u.bytes==bytes and std::memcmp(u.value,value,bytes)==0) {
+		++skipped_uploads;
+		return true;
+	}
+	std::memcpy(u.value,value,bytes); u.bytes = bytes;
+	return false;
 }
 
 void Shader::load(const std::string &fname) {
 	load(fname+".vert",fname+".frag");
 }
 
+void Shader::loadDeferred(const std::string &fname) {
+	loadDeferred(fname+".vert",fname+".frag");
+}
+
 
 bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool required) {
+	finishLoad();
 	glBindBuffer(GL_ARRAY_BUFFER,id);
-	GLint loc = glGetAttribLocation(program_id, name); 
+	GLint loc = getAttribLocation(name); 
 	if (loc==-1 and (not required)) return false;
 	cg_assert(loc!=-1,"Shader does not have required attribute");
 	glVertexAttribPointer(loc, size, type, GL_FALSE, 0, 0);
@@ -113,90 +270,187 @@ bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool
 	return true;
 }
 
-void Shader::setBuffers (const GeometryRenderer & geo) {
+static void setAttribPointer(GLint loc, const VertexAttrib &attrib) {
+	glBindBuffer(GL_ARRAY_BUFFER,attrib.buffer);
+	glVertexAttribPointer(loc, attrib.size, attrib.type, attrib.normalized, attrib.stride, 
+						  reinterpret_cast<const void*>(attrib.offset));
+	glEnableVertexAttribArray(loc);
+}
+
+void Shader::setBuffers (const GeometryRenderer & geo, bool instanced) {
+	cg_assert(geo.instancesVBO()!=0 or not instanced,"Instance matrixes not set");
+	bindBuffers(geo,instanced?geo.instancesVBO():0);
+}
+
+void Shader::setBuffers (const GeometryRenderer & geo, const InstanceBuffer &instances) {
+	cg_assert(instances.isOk(),"Instance matrixes not set");
+	bindBuffers(geo,instances.getId());
+}
+
+void Shader::bindBuffers (const GeometryRenderer & geo, GLuint instances_vbo) {
+	finishLoad();
+	bool instanced = instances_vbo!=0;
 	glBindVertexArray(geo.vertexArray());
+	const VertexLayout &layout = geo.vertexLayout(); // separate or interleaved, float or compact
 	
 	{ // positions
-		glBindBuffer(GL_ARRAY_BUFFER,geo.positionsVBO());
-		GLint loc_pos = glGetAttribLocation(program_id, "vertexPosition"); 
+		GLint loc_pos = common.position;
 		cg_assert(loc_pos!=-1,"Shader does not have vertexPositon attribute");
-		glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_pos);
+		setAttribPointer(loc_pos,layout.positions);
 	}
 	
-	GLint loc_norm = glGetAttribLocation(program_id, "vertexNormal"); 
+	GLint loc_norm = common.normal;
 	if (loc_norm!=-1) { // normals
-		cg_assert(geo.normalsVBO()!=0,"Geometry does not have normals");
-		glBindBuffer(GL_ARRAY_BUFFER,geo.normalsVBO());
-		glVertexAttribPointer(loc_norm, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_norm);
+		cg_assert(layout.normals.buffer!=0,"Geometry does not have normals");
+		setAttribPointer(loc_norm,layout.normals);
 	}
 	
-	GLint loc_tc = glGetAttribLocation(program_id, "vertexTexCoords"); 
+	GLint loc_tc = common.tex_coords;
 	if (loc_tc!=-1) { // texture coords
-		glBindBuffer(GL_ARRAY_BUFFER,geo.texCoordsVBO());
-		cg_assert(geo.texCoordsVBO()!=0,"Geometry does not have texture coordinates");
-		glVertexAttribPointer(loc_tc, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_tc);
+		cg_assert(layout.tex_coords.buffer!=0,"Geometry does not have texture coordinates");
+		setAttribPointer(loc_tc,layout.tex_coords);
 	}
 	
+	GLint loc_inst = common.instance_matrix;
+	cg_assert(loc_inst!=-1 or not instanced,"Shader does not have instanceMatrix attribute");
+	if (loc_inst!=-1) { // per instance model matrix (a mat4 uses 4 locations, one per column)
+		for(int i=0;i<4;++i) {
+			if (instanced) {
+				VertexAttrib column;
+				column.buffer = instances_vbo; column.size = 4;
+				column.stride = sizeof(glm::mat4); column.offset = i*sizeof(glm::vec4);
+				setAttribPointer(loc_inst+i,column);
+				glVertexAttribDivisor(loc_inst+i,1);
+			} else { // not instanced, constant identity
+				glDisableVertexAttribArray(loc_inst+i);
+				glVertexAttrib4f(loc_inst+i,i==0,i==1,i==2,i==3);
+			}
+		}
+	}
+	
+	// decoding uniforms (from shaders/funcs/vertexDecode.vert); they are set
+	// even for non compact geometries, since the same program can be used 
+	// for both kinds
+	const VertexDecode &decode = geo.vertexDecode();
+	bool decodes = setUniform(common.position_scale,decode.position_scale);
+	cg_assert(decodes or not geo.isCompact(),"Shader does not decode compact vertexes");
+	setUniform(common.position_offset,decode.position_offset);
+	setUniform(common.tex_coords_scale,decode.tex_coords_scale);
+	setUniform(common.tex_coords_offset,decode.tex_coords_offset);
+	setUniform(common.octahedral_normals,decode.octahedral_normals?1:0);
 }
 
-bool Shader::setUniform(const char *name, float v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform1f(pos,v);
+bool Shader::setUniform(Uniform<int> u, int v) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&v,sizeof(v))) glUniform1i(uniforms[u.slot].location,v);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::vec3 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform3f(pos,v.x,v.y,v.z);
+bool Shader::setUniform(Uniform<float> u, float v) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&v,sizeof(v))) glUniform1f(uniforms[u.slot].location,v);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::vec4 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform4f(pos,v.x,v.y,v.z,v.w);
+bool Shader::setUniform(Uniform<glm::vec2> u, const glm::vec2 &v) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&v,sizeof(v))) glUniform2f(uniforms[u.slot].location,v.x,v.y);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::mat4 &m) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniformMatrix4fv(pos, 1, GL_FALSE, &m[0][0]);
+bool Shader::setUniform(Uniform<glm::vec3> u, const glm::vec3 &v) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&v,sizeof(v))) glUniform3f(uniforms[u.slot].location,v.x,v.y,v.z);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::vec4> u, const glm::vec4 &v) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&v,sizeof(v))) glUniform4f(uniforms[u.slot].location,v.x,v.y,v.z,v.w);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::mat3> u, const glm::mat3 &m) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&m,sizeof(m))) glUniformMatrix3fv(uniforms[u.slot].location, 1, GL_FALSE, &m[0][0]);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::mat4> u, const glm::mat4 &m) {
+	if (not u.isValid()) return false;
+	if (not isUploaded(u.slot,&m,sizeof(m))) glUniformMatrix4fv(uniforms[u.slot].location, 1, GL_FALSE, &m[0][0]);
 	return true;
 }
 
+bool Shader::setUniform(const char *name, int v) {
+	return setUniform(getUniform<int>(name),v);
+}
+
+bool Shader::setUniform(const char *name, float v) {
+	return setUniform(getUniform<float>(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::vec2 &v) {
+	return setUniform(getUniform<glm::vec2>(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::vec3 &v) {
+	return setUniform(getUniform<glm::vec3>(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::vec4 &v) {
+	return setUniform(getUniform<glm::vec4>(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::mat3 &m) {
+	return setUniform(getUniform<glm::mat3>(name),m);
+}
+
+bool Shader::setUniform(const char *name, const glm::mat4 &m) {
+	return setUniform(getUniform<glm::mat4>(name),m);
+}
+
 void Shader::setMaterial (const Material &mat) {
-	setUniform("diffuseColor", mat.kd);
-	setUniform("specularColor", mat.ks);
-	setUniform("ambientColor", mat.ka);
-	setUniform("emissionColor", mat.ke);
-	setUniform("opacity", mat.opacity);
-	setUniform("shininess", mat.shininess);
+	finishLoad();
+	setUniform(common.diffuse, mat.kd);
+	setUniform(common.specular, mat.ks);
+	setUniform(common.ambient, mat.ka);
+	setUniform(common.emission, mat.ke);
+	setUniform(common.opacity, mat.opacity);
+	setUniform(common.shininess, mat.shininess);
 }
 
 Shader::~Shader ( ) {
+	if (pending.vertex_id!=0) glDeleteShader(pending.vertex_id); // never used
+	if (pending.fragment_id!=0) glDeleteShader(pending.fragment_id);
 	if (program_id!=0) glDeleteProgram(program_id);
 }
 
-void Shader::use() const {
+void Shader::use() {
 	cg_assert(program_id!=0,"Shader not initialized");
+	finishLoad();
 	glUseProgram(program_id);
 }
 
 void Shader::setMatrixes (const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection) {
-	setUniform("modelMatrix",model);
-	setUniform("viewMatrix",view);
-	setUniform("projectionMatrix",projection);
+	setModelMatrix(model,view);
+	setUniform(common.view,view);
+	setUniform(common.projection,projection);
+}
+
+void Shader::setModelMatrix (const glm::mat4 &model, const glm::mat4 &view) {
+	finishLoad();
+	setUniform(common.model,model);
+	// normal matrix: the inverse transpose of view*model, so normals stay
+	// perpendicular to the surface with non-uniform scales
+	if (common.normal_matrix.isValid()) 
+		setUniform(common.normal_matrix,glm::transpose(glm::inverse(glm::mat3(view*model))));
 }
 
 void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
-	setUniform("lightPosition",lightPosition);
-	setUniform("lightColor",lightColor);
-	setUniform("ambientStrength",ambientStrength);
+	finishLoad();
+	setUniform(common.light_position,lightPosition);
+	setUniform(common.light_color,lightColor);
+	setUniform(common.ambient_strength,ambientStrength);
 }
 
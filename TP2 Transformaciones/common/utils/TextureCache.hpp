@@ -0,0 +1,69 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// BC1 and BC3 are the S3TC formats DXT1 and DXT5 (4x4 pixel blocks of 8 and
+// 16 bytes; BC3 adds a block for the alpha channel)
+enum class TextureFormat : std::uint32_t { RGB, RGBA, BC1, BC3 };
+
+bool isCompressed(TextureFormat format);
+int channelsCount(TextureFormat format); // of the uncompressed pixels
+
+struct TextureLevel {
+	const unsigned char *data = nullptr; // rows already flipped (first row is the bottom one)
+	std::size_t size = 0;
+	int width = 0, height = 0;
+};
+
+// Decoded image, with its mipmaps or only level 0 (then OpenGL should
+// generate them). It does not own the pixels: storage keeps alive the
+// buffer (or mapped file) where the levels point.
+struct TextureImage {
+	std::shared_ptr<const void> storage;
+	std::vector<TextureLevel> levels; // empty if it could not be loaded
+	TextureFormat format = TextureFormat::RGBA;
+	bool isOk() const { return not levels.empty(); }
+	int width() const { return levels.empty() ? 0 : levels[0].width; }
+	int height() const { return levels.empty() ? 0 : levels[0].height; }
+};
+
+// None of these functions uses OpenGL, so they can run in any thread.
+
+// decodes an image file (png, jpg, etc) and flips it
+TextureImage decodeTextureImage(const std::string &fname);
+
+// generates the whole mipmap chain down to 1x1 (2x2 box filter) from level 0
+// of an uncompressed image
+TextureImage generateMipmaps(const TextureImage &img);
+
+// encodes every level of an uncompressed image as BC1 (if it has no alpha,
+// or it is always opaque) or BC3, using the shared ThreadPool
+TextureImage compressTexture(const TextureImage &img);
+
+// bytes used in the GPU, with the whole mipmap chain (uncompressed levels
+// count 4 bytes per pixel, as they are uploaded as GL_RGBA)
+std::size_t textureMemorySize(const TextureImage &img);
+
+// Binary cache with the whole mipmap chain of an image, already flipped and
+// (optionally) compressed, so it can be sent to the GPU level by level
+// without decoding the image nor generating mipmaps. Like MeshCache, it
+// remembers size and modification time of the source image, and is
+// discarded if it changed. The file is mapped, and the levels point
+// directly into it.
+
+// name of the cache file for an image (next to it)
+std::string textureCachePath(const std::string &fname, bool compressed);
+
+// isOk()==false if missing or outdated
+TextureImage readTextureCache(const std::string &cache_path);
+
+// img must have its mipmaps; the file is written with a temporary name and
+// then renamed, so an interrupted write never leaves a corrupted cache
+bool writeTextureCache(const std::string &cache_path, const std::string &source, const TextureImage &img);
+
+#endif
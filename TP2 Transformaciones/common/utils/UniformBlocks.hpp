@@ -0,0 +1,61 @@
+#ifndef UNIFORM_BLOCKS_HPP
+#define UNIFORM_BLOCKS_HPP
+#include <vector>
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/vec3.hpp>
+#include "Material.hpp"
+
+// std140 uniform blocks shared by all programs; the layouts must match the
+// ones in shaders/funcs/uniformBlocks.glsl. Shader binds the blocks it finds 
+// (by name) to these binding points when it is loaded.
+enum UniformBlockBinding { ubCamera = 0, ubMaterial = 1 };
+
+// block "Camera", updated once per frame
+struct CameraBlock {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 light_position;
+	glm::vec3 light_color;
+	float ambient_strength;
+};
+
+// block "Material", one buffer per material (see Model::material_buffer)
+struct MaterialBlock {
+	glm::vec3 ambient;  float opacity;
+	glm::vec3 diffuse;  float shininess;
+	glm::vec3 specular; float texture_layer = 0.f; // (see Model::texture_layer)
+	glm::vec3 emission; float pad1 = 0.f;
+	MaterialBlock() = default;
+	explicit MaterialBlock(const Material &m);
+};
+
+// binds the active shared blocks of a program to their binding points
+void bindUniformBlocks(GLuint program_id);
+
+// GPU buffer with the data of one block; bind() attaches it to a binding 
+// point, so every program that declares that block reads from it
+class UniformBuffer {
+public:
+	UniformBuffer() = default;
+	UniformBuffer(UniformBuffer &&other);
+	UniformBuffer &operator=(UniformBuffer &&other);
+	~UniformBuffer();
+	
+	// uploads only if the data changed since the last update
+	template<typename T> void update(const T &data) { update(&data,sizeof(T)); }
+	void update(const void *data, int size);
+	// does nothing if it was already bound there
+	void bind(UniformBlockBinding binding) const;
+	
+	bool isOk() const { return ubo!=0; }
+private:
+	UniformBuffer &operator=(const UniformBuffer &) = default;
+	void freeResources();
+	GLuint ubo = 0;
+	std::vector<unsigned char> data; // last uploaded values
+};
+
+#endif
+
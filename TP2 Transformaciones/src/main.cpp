@@ -11,12 +11,16 @@
 #include "Callbacks.hpp"
 #include "Debug.hpp"
 #include "Shaders.hpp"
+#include "RenderQueue.hpp"
+#include "UniformBlocks.hpp"
+#include "Misc.hpp"
 #include "Car.hpp"
 
 #define VERSION 20220901.2
 
 // models and settings
 bool wireframe = false, play = false, top_view = true;
+bool stress_test = false, stress_instanced = true; // prueba de carga: muchas ruedas
 
 // extra callbacks (atajos de teclado para cambiar de modo y camara)
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
@@ -28,6 +32,10 @@ std::tuple<float,float,bool> getInput(GLFWwindow *window);
 // matrices que definen la camara
 glm::mat4 projection_matrix, view_matrix;
 
+// cola donde se acumulan las partes a dibujar en cada cuadro (se dibujan
+// todas juntas, ordenadas para minimizar los cambios de estado)
+RenderQueue render_queue;
+
 // struct para guardar cada "parte" del auto
 struct Part {
 	std::string name;
@@ -35,53 +43,81 @@ struct Part {
 	std::vector<Model> models;
 };
 
-// funcin para renderizar cada "parte" del auto
+// funcin que calcula la matriz que ubica al auto (en la pista si se est
+// jugando, o rotado segn el mouse si no)
+glm::mat4 carMatrix(const Car &car) {
+	if (play) {
+		// translate segn la posicin del auto, rotacin segn el ngulo del auto.
+		return glm::mat4(cos(car.ang), 0.f, sin(car.ang), 0.f,
+						 0.f, 1.f, 0.f, 0.f,
+						 -sin(car.ang), 0.f, cos(car.ang), 0.f,
+						 car.x, 0.f, car.y, 1.f);
+	} else {
+		return glm::rotate(glm::mat4(1.f),view_angle,glm::vec3{1.f,0.f,0.f}) *
+			   glm::rotate(glm::mat4(1.f),model_angle,glm::vec3{0.f,1.f,0.f});
+	}
+}
+
+// funcin para renderizar cada "parte" del auto (la agrega a la cola, se 
+// dibuja en renderQueued)
 void renderPart(const Car &car, const std::vector<Model> &v_models, const glm::mat4 &matrix) {
 	static Shader shader("shaders/phong");
 	
-	// select a shader
-	for(const Model &model : v_models) {
+	glm::mat4 model_matrix = carMatrix(car)*matrix;
+	for(const Model &model : v_models)
+		render_queue.add(shader,model,model_matrix);
+}
+
+// funcin que dibuja todo lo que se agreg a la cola en este cuadro; la 
+// cmara y el modo de polgonos son los mismos para todas las partes (la 
+// luz est en el bloque Camera)
+void renderQueued() {
+	render_queue.setCamera(view_matrix,projection_matrix);
+	glPolygonMode(GL_FRONT_AND_BACK,(wireframe and (not play))?GL_LINE:GL_FILL);
+	render_queue.flush();
+}
+
+// funcin para renderizar varias copias de una "parte" del auto (una por 
+// cada matriz), con un solo draw call por modelo
+void renderInstances(const Car &car, std::vector<Model> &v_models, const std::vector<glm::mat4> &matrixes) {
+	static Shader shader("shaders/phong");
+	
+	for(Model &model : v_models) {
 		shader.use();
 		
-		// matrixes
-		if (play) {
-			// modifico la matriz matrix: translate segn la posicin del auto, rotacin segn el ngulo del auto.
-			shader.setMatrixes(glm::mat4(cos(car.ang), 0.f, sin(car.ang), 0.f,
-										 0.f, 1.f, 0.f, 0.f,
-										 -sin(car.ang), 0.f, cos(car.ang), 0.f,
-										 car.x, 0.f, car.y, 1.f)*matrix,view_matrix,projection_matrix);
-		} else {
-			glm::mat4 model_matrix = glm::rotate(glm::mat4(1.f),view_angle,glm::vec3{1.f,0.f,0.f}) *
-						             glm::rotate(glm::mat4(1.f),model_angle,glm::vec3{0.f,1.f,0.f}) *
-			                         matrix;
-			shader.setMatrixes(model_matrix,view_matrix,projection_matrix);
-		}
+		// matrixes (la de cada copia va en el buffer de instancias; la 
+		// cmara y la luz estn en el bloque Camera)
+		shader.setModelMatrix(carMatrix(car),view_matrix);
+		model.setInstanceMatrixes(matrixes);
 		
-		// setup light and material
-		shader.setLight(glm::vec4{20.f,-20.f,-40.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.35f);
-		shader.setMaterial(model.material);
+		// material
+		model.material_buffer.bind(ubMaterial);
 		
 		// send geometry
-		shader.setBuffers(model.buffers);
+		shader.setBuffers(*model.buffers,model.instances);
 		glPolygonMode(GL_FRONT_AND_BACK,(wireframe and (not play))?GL_LINE:GL_FILL);
-		model.buffers.draw();
+		model.drawInstanced();
 	}
 }
 
 // funcin que renderiza la pista
 void RenderTrack() {
-	static Model track = Model::loadSingle("track",Model::fDontFit);
+	static Model track = Model::loadSingle("track",Model::fDontFit|Model::fAsyncTextures|Model::fCompressTextures|Model::fStreamedTextures);
 	static Shader shader("shaders/texture");
 	shader.use();
-	shader.setMatrixes(glm::mat4(1.f),view_matrix,projection_matrix);
-	shader.setMaterial(track.material);
-	shader.setBuffers(track.buffers);
-	track.texture.bind();
+	shader.setModelMatrix(glm::mat4(1.f),view_matrix);
+	shader.setBuffers(*track.buffers);
+	track.texture->bind();
+	// pedir el nivel de detalle de la textura segn su tamao en pantalla: la 
+	// imagen se repite 3 veces en los 600 de la pista, y el punto ms cercano
+	// de la pista est a la altura de la cmara
+	float camera_height = glm::inverse(view_matrix)[3].y;
+	TextureResidency::shared().request(*track.texture,projectedSize(200.f,camera_height,glm::radians(view_fov),win_height));
 	static float aniso = -1.0f;
 	if (aniso<0) glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso); 
 	glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
-	track.buffers.draw();
+	track.draw();
 }
 
 // funcin que actualiza las matrices que definen la cmara
@@ -102,8 +138,8 @@ void setViewAndProjectionMatrixes(const Car &car) {
 }
 
 // funcin que rendiriza todo el auto, parte por parte
-void renderCar(const Car &car, const std::vector<Part> &parts) {
-	const Part &axis = parts[0], &body = parts[1], &wheel = parts[2],
+void renderCar(const Car &car, std::vector<Part> &parts) {
+	Part &axis = parts[0], &body = parts[1], &wheel = parts[2],
 	           &fwing = parts[3], &rwing = parts[4], &helmet = parts[5];
 	
 	/*
@@ -143,31 +179,30 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 	}
 	
 	if (wheel.show or play) {
+		// las cuatro ruedas son el mismo modelo, se dibujan juntas
+		std::vector<glm::mat4> wheels;
 
 		// Rueda delantera izquierda:
-		renderPart(car,wheel.models, 
-				   glm::rotate(glm::rotate(glm::mat4(0.13, 	0.0, 	0.0, 	0.0,
+		wheels.push_back(glm::rotate(glm::rotate(glm::mat4(0.13, 	0.0, 	0.0, 	0.0,
 										0.0, 	-0.13, 	0.0, 	0.0,
 										0.0, 	0.0, 	0.13, 	0.0,
 										0.5, 	0.14, 	-0.32, 	1.0 ),-car.rang1,glm::vec3{0.f,1.f,0.f}),car.rang2,glm::vec3{0.f,0.f,1.f})); 
 		// Rueda delantera derecha:
-		renderPart(car,wheel.models, 
-				   glm::rotate(glm::rotate(glm::mat4(-0.13, 	0.0, 	0.0, 	0.0,
+		wheels.push_back(glm::rotate(glm::rotate(glm::mat4(-0.13, 	0.0, 	0.0, 	0.0,
 													 0.0, 	-0.13, 	0.0, 	0.0,
 													 0.0, 	0.0, 	-0.13, 	0.0,
 													 0.5, 	0.14, 	0.32, 	1.0 ),-car.rang1,glm::vec3{0.f,1.f,0.f}),-car.rang2,glm::vec3{0.f,0.f,1.f})); // roto para que queden afuera los tornillos con truco de escala.
 		// Rueda trasera izquierda:
-		renderPart(car,wheel.models, 
-				   glm::rotate(glm::mat4(0.13, 	0.0, 	0.0, 	0.0,
+		wheels.push_back(glm::rotate(glm::mat4(0.13, 	0.0, 	0.0, 	0.0,
 										 0.0, 	-0.13, 	0.0, 	0.0,
 										 0.0, 	0.0, 	0.13, 	0.0,
 										 -0.9, 	0.14, 	-0.33, 	1.0 ),car.rang2,glm::vec3{0.f,0.f,1.f})); 
 		// Rueda trasera derecha:
-		renderPart(car,wheel.models, 
-				   glm::rotate(glm::mat4(-0.13, 	0.0, 	0.0, 	0.0,
+		wheels.push_back(glm::rotate(glm::mat4(-0.13, 	0.0, 	0.0, 	0.0,
 										 0.0, 	-0.13, 	0.0, 	0.0,
 										 0.0, 	0.0, 	-0.13, 	0.0,
 										 -0.9, 	0.14, 	0.33, 	1.0 ),-car.rang2,glm::vec3{0.f,0.f,1.f})); // roto para que queden afuera los tornillos.
+		renderInstances(car,wheel.models,wheels);
 	}
 	
 	if (fwing.show or play) {
@@ -195,6 +230,25 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 	if (axis.show and (not play)) renderPart(car,axis.models,glm::mat4(1.f));
 }
 
+// prueba de carga: una grilla de 100x100 ruedas, en un solo draw call o en 
+// uno por rueda
+void renderStressTest(const Car &car, std::vector<Model> &wheel_models) {
+	const int n = 100;
+	std::vector<glm::mat4> matrixes; matrixes.reserve(n*n);
+	for(int i=0;i<n;++i) { 
+		for(int j=0;j<n;++j) { 
+			glm::vec3 pos = {(i-n/2)*0.3f, -0.5f, (j-n/2)*0.3f};
+			matrixes.push_back(glm::scale(glm::translate(glm::mat4(1.f),pos),glm::vec3{0.1f,0.1f,0.1f}));
+		}
+	}
+	if (stress_instanced) {
+		renderInstances(car,wheel_models,matrixes);
+	} else {
+		for(const glm::mat4 &m : matrixes) 
+			renderPart(car,wheel_models,m);
+	}
+}
+
 // main: crea la ventana, carga los modelos e implementa el bucle principal
 int main() {
 	
@@ -221,6 +275,7 @@ int main() {
 	Track track("mapa.png",100,100);
 	
 	FrameTimer ftime;
+	UniformBuffer camera_buffer; // cmara y luz, compartidas por todos los shaders
 	double accum_dt = 0.0;
 	double lap_time = 0.0;
 	double last_lap = 0.0;
@@ -228,6 +283,9 @@ int main() {
 		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
+		// subir de a partes las texturas que se cargan en segundo plano (la de la pista)
+		TextureUploader::shared().update();
+		
 		// actualizar las pos del auto y de la camara
 		double elapsed_time = ftime.newFrame();
 		accum_dt += elapsed_time;
@@ -243,8 +301,14 @@ int main() {
 		}
 		
 		// setear matrices y renderizar
+		camera_buffer.update(CameraBlock{view_matrix,projection_matrix,
+										 glm::vec4{20.f,-20.f,-40.f,0.f},glm::vec3{1.f,1.f,1.f},0.35f});
+		camera_buffer.bind(ubCamera);
 		if (play) RenderTrack();
 		renderCar(car,parts);
+		if (stress_test and (not play)) renderStressTest(car,parts[2].models);
+		renderQueued();
+		TextureResidency::shared().update(); // (con los pedidos de este cuadro)
 		
 		// settings sub-window
 		window.ImGuiDialog("CG Example",[&](){
@@ -259,6 +323,33 @@ int main() {
 						ImGui::Checkbox(p.name.c_str(),&p.show);
 					ImGui::TreePop();
 				}
+				if (ImGui::TreeNode("Stress test")) {
+					ImGui::Checkbox("10000 wheels",&stress_test);
+					ImGui::Checkbox("Instanced",&stress_instanced);
+					ImGui::LabelText("","%d fps",ftime.getFrameRate());
+					ImGui::TreePop();
+				}
+				if (ImGui::TreeNode("Render queue")) {
+					const RenderQueue::Stats &st = render_queue.stats();
+					ImGui::LabelText("","items: %d",st.items);
+					ImGui::LabelText("","programs: %d",st.programs);
+					ImGui::LabelText("","textures: %d",st.textures);
+					ImGui::LabelText("","materials: %d",st.materials);
+					ImGui::LabelText("","buffers: %d",st.buffers);
+					ImGui::LabelText("","saved changes: %d",st.saved);
+					ImGui::TreePop();
+				}
+			}
+			if (ImGui::TreeNode("Textures")) {
+				const TextureResidency::Stats &st = TextureResidency::shared().stats();
+				int budget_mb = static_cast<int>(TextureResidency::shared().getBudget()>>20);
+				if (ImGui::SliderInt("budget (MB)",&budget_mb,1,256))
+					TextureResidency::shared().setBudget(std::size_t(budget_mb)<<20);
+				ImGui::LabelText("","resident: %.1f MB",st.resident_bytes/1048576.f);
+				ImGui::LabelText("","needed: %.1f MB",st.needed_bytes/1048576.f);
+				ImGui::LabelText("","all levels: %.1f MB",st.full_bytes/1048576.f);
+				ImGui::LabelText("","levels in/out: %d/%d",st.loaded_levels,st.dropped_levels);
+				ImGui::TreePop();
 			}
 			if (ImGui::TreeNode("car")) {
 				ImGui::LabelText("","x: %f",car.x);
@@ -6,6 +6,7 @@ in vec3 vertexNormal;
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform mat3 normalMatrix;
 uniform vec4 lightPosition;
 
 out vec3 fragPosition;
@@ -17,6 +18,6 @@ void main() {
 	vec4 vmp = vm * vec4(vertexPosition,1.f);
 	fragPosition = vec3(vmp);
 	gl_Position = projectionMatrix * vmp;
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
+	fragNormal = normalMatrix * vertexNormal;
 	lightVSPosition = vm * lightPosition;
 }
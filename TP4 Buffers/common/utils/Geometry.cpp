@@ -2,41 +2,59 @@
 #include "Geometry.hpp"
 #include "Debug.hpp"
 
-template<typename vector>
-static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic) {
+static void updateBuffer(GLenum type, GLuint &id, const void *data, std::size_t bytes, bool realloc, bool dynamic) {
 	if (id==0) {
 		cg_assert(realloc,"Texture coordinates not initialized");
 		glGenBuffers(1, &id);
 	}
 	glBindBuffer(type, id);
 	if (realloc) {
-		glBufferData(type, v.size()*sizeof(typename vector::value_type), v.data(), dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+		glBufferData(type, bytes, data, dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
 	} else
-		glBufferSubData(type, 0, v.size()*sizeof(typename vector::value_type), v.data());
+		glBufferSubData(type, 0, bytes, data);
+}
+
+template<typename vector>
+static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic) {
+	updateBuffer(type,id,v.data(),v.size()*sizeof(typename vector::value_type),realloc,dynamic);
 }
 
 GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic) {
-	
-	cg_assert(geo.positions.size(),"Empty Geometry");
+	cg_assert(geo.normals.empty() or geo.normals.size()==geo.positions.size(),"Wrong normals count");
+	cg_assert(geo.tex_coords.empty() or geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
+	init(geo.positions.data(), 
+		 geo.normals.empty() ? nullptr : geo.normals.data(),
+		 geo.tex_coords.empty() ? nullptr : geo.tex_coords.data(),
+		 geo.positions.size(), 
+		 geo.triangles.empty() ? nullptr : geo.triangles.data(),
+		 geo.triangles.size(), dynamic);
+}
+
+GeometryRenderer::GeometryRenderer(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+								   int vertex_count, const int *triangles, int index_count, bool dynamic) 
+{
+	init(positions,normals,tex_coords,vertex_count,triangles,index_count,dynamic);
+}
+
+void GeometryRenderer::init(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+							int vertex_count, const int *triangles, int index_count, bool dynamic) 
+{
+	cg_assert(vertex_count,"Empty Geometry");
 	
 	glGenVertexArrays(1,&VAO);
 	glBindVertexArray(VAO);
 	
-	updateBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,true,dynamic);
+	updateBuffer(GL_ARRAY_BUFFER,VBO_pos,positions,vertex_count*sizeof(glm::vec3),true,dynamic);
 	
-	if (not geo.normals.empty()) {
-		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,true,dynamic);  
-	}
-	if (not geo.tex_coords.empty()) {
-		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,true, dynamic);  
-	}
-	if (not geo.triangles.empty()) {
-		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,geo.triangles,true,dynamic);
-		count = geo.triangles.size();
+	if (normals)
+		updateBuffer(GL_ARRAY_BUFFER,VBO_norms,normals,vertex_count*sizeof(glm::vec3),true,dynamic);  
+	if (tex_coords)
+		updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,tex_coords,vertex_count*sizeof(glm::vec2),true,dynamic);  
+	if (triangles and index_count) {
+		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,triangles,index_count*sizeof(int),true,dynamic);
+		count = index_count;
 	} else 
-		count = geo.positions.size();
+		count = vertex_count;
 	
 	glBindVertexArray(0);
 }
@@ -19,6 +19,10 @@ class GeometryRenderer {
 public:
 	GeometryRenderer() = default;
 	GeometryRenderer(const Geometry &geo, bool dynamic=false);
+	// same, but from raw arrays (normals and tex_coords can be null; 
+	// if triangles is null, vertexes are drawn as consecutive triangles)
+	GeometryRenderer(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+					 int vertex_count, const int *triangles, int index_count, bool dynamic=false);
 	GeometryRenderer(GeometryRenderer &&geo);
 	GeometryRenderer &operator=(GeometryRenderer &&geo);
 	void draw() const;
@@ -36,6 +40,8 @@ public:
 private:
 	GeometryRenderer(const GeometryRenderer &) = delete;
 	GeometryRenderer &operator=(const GeometryRenderer &) = default;
+	void init(const glm::vec3 *positions, const glm::vec3 *normals, const glm::vec2 *tex_coords,
+			  int vertex_count, const int *triangles, int index_count, bool dynamic);
 	void freeResources();
 	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0;
 	int count = 0;
@@ -0,0 +1,172 @@
+#include <cstring>
+#include <ostream>
+#include <sys/stat.h>
+#include "MeshCache.hpp"
+#include "Debug.hpp"
+#include "Misc.hpp"
+
+// File layout (native endianness, every field 4-byte aligned):
+//   header:  magic "CGMC", version, key, parts count, total parts count
+//   sources: count, and for each one: path (u32 length + chars, padded to 4),
+//            u64 size, i64 modification time
+//   parts:   for each one: ka kd ks ke (12 floats), shininess, opacity,
+//            texture (same as paths), vertex count, has normals, 
+//            has tex_coords, index count, and then the arrays: positions,
+//            normals, tex_coords, triangles
+
+namespace {
+	
+const char cache_magic[4] = {'C','G','M','C'};
+const std::uint32_t cache_version = 1;
+
+bool getFileStamp(const std::string &fname, std::uint64_t &size, std::int64_t &mtime) {
+	struct stat st;
+	if (::stat(fname.c_str(),&st)!=0) return false;
+	size = static_cast<std::uint64_t>(st.st_size);
+	mtime = static_cast<std::int64_t>(st.st_mtime);
+	return true;
+}
+
+// bounds-checked sequential reads from the mapped file
+struct Reader {
+	const char *p, *end;
+	bool ok = true;
+	const char *take(std::size_t bytes) {
+		bytes = (bytes+3)&~std::size_t(3);
+		if (not ok or static_cast<std::size_t>(end-p)<bytes) { ok = false; return nullptr; }
+		const char *r = p; p += bytes;
+		return r;
+	}
+	template<typename T> T get() {
+		T v{}; const char *r = take(sizeof(T));
+		if (r) std::memcpy(&v,r,sizeof(T));
+		return v;
+	}
+	std::string getString() {
+		std::uint32_t len = get<std::uint32_t>();
+		const char *r = take(len);
+		return r ? std::string(r,len) : std::string();
+	}
+	template<typename T> const T *getArray(std::uint32_t count) {
+		return reinterpret_cast<const T*>(take(std::size_t(count)*sizeof(T)));
+	}
+};
+
+template<typename T>
+void put(std::ostream &f, const T &v) { f.write(reinterpret_cast<const char*>(&v),sizeof(T)); }
+
+void putPadded(std::ostream &f, const void *data, std::size_t bytes) {
+	static const char zeros[4] = {0,0,0,0};
+	f.write(static_cast<const char*>(data),bytes);
+	f.write(zeros,(4-bytes%4)%4);
+}
+
+void putString(std::ostream &f, const std::string &s) {
+	put(f,static_cast<std::uint32_t>(s.size()));
+	putPadded(f,s.data(),s.size());
+}
+
+}
+
+std::string meshCachePath(const std::string &obj_path, std::uint32_t key) {
+	return obj_path+"."+std::to_string(key)+".mcache";
+}
+
+MeshCache::MeshCache(const std::string &cache_path, std::uint32_t key) : file(cache_path) {
+	if (not file.isOk()) return;
+	Reader r{file.begin(),file.end()};
+	
+	const char *magic = r.take(4);
+	if (not magic or std::memcmp(magic,cache_magic,4)!=0) return;
+	if (r.get<std::uint32_t>()!=cache_version or r.get<std::uint32_t>()!=key) return;
+	std::uint32_t parts_count = r.get<std::uint32_t>(), total_parts_count = r.get<std::uint32_t>();
+	
+	std::uint32_t sources_count = r.get<std::uint32_t>();
+	for(std::uint32_t i=0;r.ok and i<sources_count;++i) {
+		std::string fname = r.getString();
+		std::uint64_t size = r.get<std::uint64_t>(), cur_size;
+		std::int64_t mtime = r.get<std::int64_t>(), cur_mtime;
+		if (not getFileStamp(fname,cur_size,cur_mtime) or cur_size!=size or cur_mtime!=mtime) {
+			cg_info("Outdated mesh cache: "+cache_path);
+			return;
+		}
+	}
+	
+	std::vector<Part> aux_parts(parts_count);
+	for(Part &part : aux_parts) {
+		Material &m = part.material;
+		const float *k = r.getArray<float>(14);
+		if (not k) return;
+		m.ka = {k[0],k[1],k[2]}; m.kd = {k[3],k[4],k[5]};
+		m.ks = {k[6],k[7],k[8]}; m.ke = {k[9],k[10],k[11]};
+		m.shininess = k[12]; m.opacity = k[13];
+		m.texture = r.getString();
+		std::uint32_t nverts = r.get<std::uint32_t>(), has_normals = r.get<std::uint32_t>(),
+			has_tcs = r.get<std::uint32_t>(), nindices = r.get<std::uint32_t>();
+		part.vertex_count = nverts; part.index_count = nindices;
+		part.positions = r.getArray<glm::vec3>(nverts);
+		if (has_normals) part.normals = r.getArray<glm::vec3>(nverts);
+		if (has_tcs) part.tex_coords = r.getArray<glm::vec2>(nverts);
+		part.triangles = r.getArray<int>(nindices);
+	}
+	if (not r.ok or parts_count==0) return;
+	
+	vparts = std::move(aux_parts);
+	complete = parts_count==total_parts_count;
+}
+
+Geometry MeshCache::Part::toGeometry() const {
+	Geometry g;
+	g.positions.assign(positions,positions+vertex_count);
+	if (normals) g.normals.assign(normals,normals+vertex_count);
+	if (tex_coords) g.tex_coords.assign(tex_coords,tex_coords+vertex_count);
+	if (triangles) g.triangles.assign(triangles,triangles+index_count);
+	return g;
+}
+
+MeshCacheWriter::MeshCacheWriter(const std::string &cache_path, std::uint32_t key, 
+								 const std::vector<std::string> &sources, int parts_count, int total_parts_count) 
+	: path(cache_path), key(key), sources(sources), parts_count(parts_count), total_parts_count(total_parts_count)
+{
+	parts.reserve(parts_count);
+}
+
+void MeshCacheWriter::addPart(const Geometry &geo, const Material &m) {
+	parts.push_back({&geo,&m});
+}
+
+bool MeshCacheWriter::finish() {
+	if (static_cast<int>(parts.size())!=parts_count) return false;
+	bool saved = replaceFile(path,[this](std::ostream &file) {
+		file.write(cache_magic,4);
+		put(file,cache_version); put(file,key);
+		put(file,static_cast<std::uint32_t>(parts_count)); 
+		put(file,static_cast<std::uint32_t>(total_parts_count));
+		put(file,static_cast<std::uint32_t>(sources.size()));
+		for(const std::string &fname : sources) {
+			std::uint64_t size = 0; std::int64_t mtime = 0;
+			if (not getFileStamp(fname,size,mtime)) return false;
+			putString(file,fname); put(file,size); put(file,mtime);
+		}
+		for(const PartRef &part : parts) {
+			const Geometry &geo = *part.geo; const Material &m = *part.mat;
+			const float k[14] = { m.ka.x, m.ka.y, m.ka.z, m.kd.x, m.kd.y, m.kd.z,
+								  m.ks.x, m.ks.y, m.ks.z, m.ke.x, m.ke.y, m.ke.z,
+								  m.shininess, m.opacity };
+			put(file,k);
+			putString(file,m.texture);
+			bool has_normals = not geo.normals.empty(), has_tcs = not geo.tex_coords.empty();
+			put(file,static_cast<std::uint32_t>(geo.positions.size()));
+			put(file,static_cast<std::uint32_t>(has_normals));
+			put(file,static_cast<std::uint32_t>(has_tcs));
+			put(file,static_cast<std::uint32_t>(geo.triangles.size()));
+			putPadded(file,geo.positions.data(),geo.positions.size()*sizeof(glm::vec3));
+			if (has_normals) putPadded(file,geo.normals.data(),geo.normals.size()*sizeof(glm::vec3));
+			if (has_tcs) putPadded(file,geo.tex_coords.data(),geo.tex_coords.size()*sizeof(glm::vec2));
+			putPadded(file,geo.triangles.data(),geo.triangles.size()*sizeof(int));
+		}
+		return true;
+	});
+	if (saved) cg_info("Mesh cache saved: "+path);
+	return saved;
+}
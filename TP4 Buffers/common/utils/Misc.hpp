@@ -1,5 +1,7 @@
 #ifndef MISC_HPP
 #define MISC_HPP
+#include <functional>
+#include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -13,5 +15,14 @@ bool startsWith(const std::string str, const char *con);
 
 std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v);
 
+// name for a temporary file next to path, different for every call (also
+// from other threads or processes), to write it there and then rename it
+std::string uniqueTempPath(const std::string &path);
+// writes path through one of those temporary files, so a failed or 
+// interrupted write (or two writers at once) never leaves it half written;
+// false if write returns false or the file can't be written (and then 
+// path is not modified)
+bool replaceFile(const std::string &path, const std::function<bool(std::ostream&)> &write);
+
 #endif
 
@@ -5,34 +5,130 @@
 #include "Debug.hpp"
 #include "ObjMesh.hpp"
 #include "Misc.hpp"
+#include "ThreadPool.hpp"
 
-Model Model::loadSingle(const std::string &name, int flags) {
-	ObjMesh obj = readObj("models/"+name+".obj");
-	if (!(flags&fDontFit)) centerAndResize(obj.positions);
+namespace {
+	
+// only the flags that change the generated geometry are part of the cache key
+std::uint32_t cacheKey(int flags) {
+	return flags&(Model::fDontFit|Model::fRegenerateNormals|Model::fNoTextures);
+}
+
+// reads a single part, but fits it as if the whole model was read
+Geometry readPart(const ObjIndex &index, int ipart, int flags, ObjMesh &obj) {
+	obj = index.readPart(ipart);
+	if (flags&Model::fNoTextures) obj.parts[0].material.texture.clear();
+	if (!(flags&Model::fDontFit)) {
+		if (static_cast<int>(obj.positions.size())==index.positionsCount()) 
+			centerAndResize(obj.positions);
+		else
+			centerAndResize(obj.positions,index.boundingBox());
+	}
 	Geometry geometry = toGeometry(obj,0);
-	if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-	if (flags&fNoTextures) obj.parts[0].material.texture.clear();
+	if (flags&Model::fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
+	return geometry;
+}
+
+std::vector<std::string> cacheSources(const std::string &obj_path, const ObjMesh &obj) {
+	std::vector<std::string> sources = { obj_path };
+	sources.insert(sources.end(),obj.material_libs.begin(),obj.material_libs.end());
+	return sources;
+}
+
+// loadSingle without the cache lookup (but saving the cache)
+ModelData parseSingle(const std::string &name, int flags) {
+	std::string obj_path = "models/"+name+".obj";
+	ObjIndex index(obj_path);
+	ObjMesh obj;
+	Geometry geometry = readPart(index,0,flags,obj);
+	if (!(flags&Model::fNoCache)) {
+		MeshCacheWriter writer(meshCachePath(obj_path,cacheKey(flags)),cacheKey(flags),
+							   cacheSources(obj_path,obj),1,index.partsCount());
+		writer.addPart(geometry,obj.parts[0].material);
+		writer.finish();
+	}
+	return {std::move(geometry), obj.parts[0].material, flags};
+}
+	
+}
+
+Model Model::loadSingle(const std::string &name, int flags) {
+	if (!(flags&fNoCache)) { // upload directly from the mapped cache
+		MeshCache cache(meshCachePath("models/"+name+".obj",cacheKey(flags)),cacheKey(flags));
+		if (cache.isOk()) return Model(cache.parts()[0], flags&fKeepGeometry);
+	}
+	return Model(parseSingle(name,flags));
+}
+
+ModelData Model::loadSingleData(const std::string &name, int flags) {
+	if (!(flags&fNoCache)) {
+		MeshCache cache(meshCachePath("models/"+name+".obj",cacheKey(flags)),cacheKey(flags));
+		if (cache.isOk()) return {cache.parts()[0].toGeometry(), cache.parts()[0].material, flags};
+	}
+	return parseSingle(name,flags);
+}
+
+std::future<ModelData> Model::loadSingleAsync(const std::string &name, int flags) {
+	return ThreadPool::shared().submit([name,flags]() { return loadSingleData(name,flags); });
+}
+
+Model Model::loadPart(const ObjIndex &index, const std::string &part_name, int flags) {
+	int ipart = index.findPart(part_name);
+	cg_assert(ipart!=-1,"Part name not found");
+	ObjMesh obj;
+	Geometry geometry = readPart(index,ipart,flags,obj);
 	return Model(std::move(geometry), obj.parts[0].material, flags&fKeepGeometry);
 }
 
+Model Model::loadPart(const std::string &name, const std::string &part_name, int flags) {
+	return loadPart(ObjIndex("models/"+name+".obj"),part_name,flags);
+}
+
 std::vector<Model> Model::load(const std::string &name, int flags) {
-	auto obj = readObj("models/"+name+".obj");
+	std::string obj_path = "models/"+name+".obj";
+	std::string cache_path = meshCachePath(obj_path,cacheKey(flags));
+	if (!(flags&fNoCache)) {
+		MeshCache cache(cache_path,cacheKey(flags));
+		if (cache.isOk() and cache.isComplete()) {
+			std::vector<Model> vret; vret.reserve(cache.parts().size());
+			for (const auto &part : cache.parts())
+				vret.emplace_back(part, flags&fKeepGeometry);
+			return vret;
+		}
+	}
+	
+	auto obj = readObj(obj_path);
 	if (!(flags&fDontFit)) centerAndResize(obj.positions);
 	
-	std::vector<Model> vret; vret.reserve(obj.parts.size());
+	std::vector<Geometry> geometries; geometries.reserve(obj.parts.size());
 	for (auto &part : obj.parts) {
-		Geometry geometry = toGeometry(obj,part);
-		if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
 		if (flags&fNoTextures) part.material.texture.clear();
-		vret.emplace_back(std::move(geometry), part.material, flags&fKeepGeometry);
+		geometries.push_back(toGeometry(obj,part));
+		Geometry &geometry = geometries.back();
+		if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
+	}
+	
+	if (!(flags&fNoCache)) {
+		MeshCacheWriter writer(cache_path,cacheKey(flags),cacheSources(obj_path,obj),
+							   obj.parts.size(),obj.parts.size());
+		for (std::size_t i=0;i<geometries.size();++i) 
+			writer.addPart(geometries[i],obj.parts[i].material);
+		writer.finish();
 	}
+	
+	std::vector<Model> vret; vret.reserve(obj.parts.size());
+	for (std::size_t i=0;i<geometries.size();++i)
+		vret.emplace_back(std::move(geometries[i]), obj.parts[i].material, flags&fKeepGeometry);
 	return vret;
 }
 
 void centerAndResize(std::vector<glm::vec3> &v) {
-	// get global bb
+	centerAndResize(v,getBoundingBox(v));
+}
+
+void centerAndResize(std::vector<glm::vec3> &v, const std::pair<glm::vec3,glm::vec3> &bb) {
 	glm::vec3 pmin, pmax;
-	std::tie(pmin,pmax) = getBoundingBox(v);
+	std::tie(pmin,pmax) = bb;
 	
 	// center on 0,0,0
 	glm::vec3 center = (pmax+pmin)/2.f;
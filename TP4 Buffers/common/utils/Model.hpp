@@ -1,9 +1,21 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 #include <vector>
+#include <future>
 #include "Geometry.hpp"
 #include "Material.hpp"
 #include "Texture.hpp"
+#include "MeshCache.hpp"
+#include "ObjMesh.hpp"
+
+// CPU side of a model (everything but the GPU buffers and texture), so it 
+// can be loaded in another thread and turned into a Model later, in the 
+// thread that owns the OpenGL context
+struct ModelData {
+	Geometry geometry;
+	Material material;
+	int flags = 0;
+};
 
 // auxiliar struct for loading all model-related data
 struct Model {
@@ -25,14 +37,34 @@ struct Model {
 	{
 		if (keep_geometry) geometry = std::move(g);
 	}
+	Model(ModelData &&d) : Model(std::move(d.geometry), d.material, d.flags&fKeepGeometry) { }
+	Model(const MeshCache::Part &p, bool keep_geometry=false) 
+		: buffers(p.positions,p.normals,p.tex_coords,p.vertex_count,p.triangles,p.index_count), 
+		  material(p.material), 
+		  texture(p.material.texture.empty() ? Texture() : Texture(p.material.texture))
+	{
+		if (keep_geometry) geometry = p.toGeometry();
+	}
 	
 	enum Flags { fNone=0, fDontFit=1, fKeepGeometry=2, 
-				 fRegenerateNormals=4, fDynamic=8, fNoTextures=16 };
+				 fRegenerateNormals=4, fDynamic=8, fNoTextures=16, 
+				 fNoCache=32 // don't read nor write the binary mesh cache
+	};
 	static std::vector<Model> load(const std::string &name, int flags = 0);
 	static Model loadSingle(const std::string &name, int flags = 0);
+	// same as loadSingle, but without touching OpenGL, so it can run in any
+	// thread; loadSingleAsync runs it in the shared ThreadPool (use the 
+	// future's result to construct the Model in the main thread)
+	static ModelData loadSingleData(const std::string &name, int flags = 0);
+	static std::future<ModelData> loadSingleAsync(const std::string &name, int flags = 0);
+	// loads only one part (only that part is parsed, see ObjIndex); the 
+	// overload with an index avoids scanning the file again for each part
+	static Model loadPart(const std::string &name, const std::string &part_name, int flags = 0);
+	static Model loadPart(const ObjIndex &index, const std::string &part_name, int flags = 0);
 };
 
 void centerAndResize(std::vector<glm::vec3> &v);
+void centerAndResize(std::vector<glm::vec3> &v, const std::pair<glm::vec3,glm::vec3> &bb); // with a given bounding box
 
 #endif
 
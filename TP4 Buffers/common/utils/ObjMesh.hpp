@@ -8,6 +8,7 @@
 #include "ObjMesh.hpp"
 #include "Material.hpp"
 #include "Geometry.hpp"
+#include "MappedFile.hpp"
 
 struct ObjMesh {
 	
@@ -27,11 +28,54 @@ struct ObjMesh {
 	};
 	std::vector<Part> parts;
 	
+	std::vector<std::string> material_libs; // full paths of the .mtl files read
+	
 	const Part &getPart(const std::string &name) const;
 	
 };
 
-ObjMesh readObj(const std::string &full_path);
+// Stream reads line by line with std::getline; Mapped maps the whole file and
+// parses it in place, without allocating memory for each line; Parallel also
+// maps it, but splits it in chunks parsed by the shared ThreadPool (small
+// files are still parsed as Mapped). All of them give the same ObjMesh.
+enum class ObjReadMode { Stream, Mapped, Parallel };
+
+ObjMesh readObj(const std::string &full_path, ObjReadMode mode=ObjReadMode::Parallel);
+
+// Index of the parts of an .obj file, built by a quick scan that only looks
+// at the beginning of each line (numbers are not parsed). It records where 
+// the faces of each part and the vertex data are, so a single part can be
+// read without parsing the rest of the file. The file stays mapped while
+// the index exists.
+class ObjIndex {
+public:
+	ObjIndex(const std::string &full_path);
+	
+	int partsCount() const { return parts.size(); }
+	const std::string &partName(int i) const { return parts[i].name; }
+	int findPart(const std::string &name) const; // -1 if not found
+	int positionsCount() const { return positions.empty() ? 0 : positions.back().first+positions.back().count; }
+	
+	// returns an ObjMesh with just that part, and only the range of 
+	// vertex data it uses (indexes are adjusted to that range)
+	ObjMesh readPart(int ipart) const;
+	ObjMesh readPart(const std::string &name) const;
+	
+	// bounding box of all the positions in the file (as readObj+getBoundingBox)
+	std::pair<glm::vec3,glm::vec3> boundingBox() const;
+	
+private:
+	struct Range { const char *begin, *end; }; // whole lines
+	struct Run { const char *begin, *end; int first, count; }; // consecutive lines with vertex data
+	struct PartInfo {
+		std::string name, material, material_lib;
+		std::vector<Range> faces;
+	};
+	std::string path;
+	MappedFile file;
+	std::vector<PartInfo> parts;
+	std::vector<Run> positions, normals, tex_coords;
+};
 
 Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part);
 Geometry toGeometry(const ObjMesh &obj, int ipart=0);
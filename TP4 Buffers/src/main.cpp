@@ -2,6 +2,8 @@
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <future>
+#include <chrono>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -49,7 +51,9 @@ int main() {
 	// main loop
 	mfloor = Model::loadSingle("floor",Model::fDontFit);
 	mlight = Model::loadSingle("light",Model::fDontFit);
-	int loaded_model = -1;
+	mobject = Model::loadSingle(models_names[current_model]);
+	int loaded_model = current_model, loading_model = -1;
+	std::future<ModelData> next_model;
 	FrameTimer ftime;
 	view_target.y = .75f;
 	view_pos.z *= 2;
@@ -57,10 +61,15 @@ int main() {
 		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
 		
-		// reload model if necessary
-		if (loaded_model!=current_model) { 
-			mobject = Model::loadSingle(models_names[current_model]);
-			loaded_model = current_model;
+		// reload model if necessary (parsed in background, the old one
+		// is drawn until the new one is ready)
+		if (loaded_model!=current_model and not next_model.valid()) { 
+			next_model = Model::loadSingleAsync(models_names[current_model]);
+			loading_model = current_model;
+		}
+		if (next_model.valid() and next_model.wait_for(std::chrono::seconds(0))==std::future_status::ready) {
+			mobject = Model(next_model.get());
+			loaded_model = loading_model;
 		}
 		
 		view_angle = std::min(std::max(view_angle,0.01f),1.72f);
@@ -119,6 +128,7 @@ int main() {
 		// settings sub-window
 		window.ImGuiDialog("CG Example",[&](){
 			ImGui::Combo(".obj (O)", &current_model,models_names);		
+			if (next_model.valid()) ImGui::Text("Loading %s...",models_names[loading_model].c_str());
 			ImGui::Checkbox("Rotate Object (R)",&rotate_object);
 			ImGui::Checkbox("Rotate Light (L)",&rotate_light);
 			ImGui::Checkbox("Show Stencil (S)",&show_stencil);
@@ -6,6 +6,7 @@ in vec3 vertexNormal;
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform mat3 normalMatrix;
 uniform vec4 lightPosition;
 uniform float t;
 
@@ -19,6 +20,6 @@ void main() {
 	pos.z += pow(cos( (1.f-pos.x)/2.f ),25)*.1 * sin(fract(t)*2*3.1415926538);
 	gl_Position = projectionMatrix * viewMatrix * modelMatrix * pos;
 	fragPosition = vec3(modelMatrix * pos);
-	fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	fragNormal = normalMatrix * vertexNormal;
 	lightVSPosition = viewMatrix * lightPosition;
 }
@@ -6,6 +6,7 @@ in vec3 vertexNormal;
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform mat3 normalMatrix;
 uniform vec4 lightPosition;
 
 out vec3 fragPosition;
@@ -15,6 +16,6 @@ out vec4 lightVSPosition;
 void main() {
 	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
 	fragPosition = vec3(viewMatrix * modelMatrix * vec4(vertexPosition,1.f));
-	fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	fragNormal = normalMatrix * vertexNormal;
 	lightVSPosition = viewMatrix * lightPosition;
 }
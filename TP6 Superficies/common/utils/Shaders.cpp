@@ -3,6 +3,7 @@
 #include <vector>
 #include <iostream>
 #include <glad/glad.h>
+#include <glm/matrix.hpp>
 #include "Shaders.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
@@ -28,6 +29,7 @@ static std::string getShaderSource(std::string file_path) {
 	return full_content;
 }
 
+// only submits the source, see checkShader
 static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
 	GLuint shader_id = glCreateShader(shader_type);
 	
@@ -38,6 +40,11 @@ static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
 	glShaderSource(shader_id,1,&shader_code_ptr,nullptr);
 	glCompileShader(shader_id);
 	
+	return shader_id;
+}
+
+// waits for the compilation to end
+static void checkShader(GLuint shader_id, const std::string &file_path) {
 	GLint result = GL_FALSE, log_len = 0;
 	glGetShaderiv(shader_id,GL_COMPILE_STATUS,&result);
 	glGetShaderiv(shader_id,GL_INFO_LOG_LENGTH,&log_len);
@@ -47,8 +54,6 @@ static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
 		std::cerr << log.data() << std::endl;
 	}
 	cg_assert(result==GL_TRUE,"Failed to compile shader "+std::string(file_path));
-	
-	return shader_id;
 }
 
 Shader::Shader (const std::string &vertex_fname, const std::string &fragment_fname) {
@@ -71,15 +76,40 @@ Shader &Shader::operator=(Shader &&other) {
 }
 
 void Shader::load(const std::string &vertex_fname, const std::string &fragment_fname) {
+	loadDeferred(vertex_fname,fragment_fname);
+	finishLoad();
+}
+
+void Shader::loadDeferred(const std::string &vertex_fname, const std::string &fragment_fname) {
 	cg_assert(program_id==0,"Shader already loaded");
-	GLuint vertex_id = loadAndCompile(GL_VERTEX_SHADER,vertex_fname);
-	GLuint fragment_id = loadAndCompile(GL_FRAGMENT_SHADER,fragment_fname);
+	static bool threads_set = false;
+	if (GLAD_GL_KHR_parallel_shader_compile and not threads_set) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many as the driver wants
+		threads_set = true;
+	}
+	
+	pending.vertex_fname = vertex_fname; pending.fragment_fname = fragment_fname;
+	pending.vertex_id = loadAndCompile(GL_VERTEX_SHADER,vertex_fname);
+	pending.fragment_id = loadAndCompile(GL_FRAGMENT_SHADER,fragment_fname);
 	
 	cg_info( "Linking shader program..." );
 	program_id = glCreateProgram();
-	glAttachShader(program_id,vertex_id);
-	glAttachShader(program_id,fragment_id);
+	glAttachShader(program_id,pending.vertex_id);
+	glAttachShader(program_id,pending.fragment_id);
 	glLinkProgram(program_id);
+}
+
+bool Shader::isReady() const {
+	if (pending.vertex_id==0 or not GLAD_GL_KHR_parallel_shader_compile) return true;
+	GLint done = GL_TRUE;
+	glGetProgramiv(program_id,GL_COMPLETION_STATUS_KHR,&done);
+	return done==GL_TRUE;
+}
+
+void Shader::finishLoad() {
+	if (pending.vertex_id==0) return;
+	checkShader(pending.vertex_id,pending.vertex_fname);
+	checkShader(pending.fragment_id,pending.fragment_fname);
 	
 	GLint result = GL_FALSE, log_len = 0;
 	glGetProgramiv(program_id,GL_LINK_STATUS,&result);
@@ -91,17 +121,22 @@ void Shader::load(const std::string &vertex_fname, const std::string &fragment_f
 	}
 	cg_assert(result==GL_TRUE,"Failed to link shader program");
 	
-	glDetachShader(program_id,vertex_id);
-	glDetachShader(program_id,fragment_id);
+	glDetachShader(program_id,pending.vertex_id);
+	glDetachShader(program_id,pending.fragment_id);
 	
-	glDeleteShader(vertex_id);
-	glDeleteShader(fragment_id);
+	glDeleteShader(pending.vertex_id);
+	glDeleteShader(pending.fragment_id);
+	pending = PendingLoad();
 }
 
 void Shader::load(const std::string &fname) {
 	load(fname+".vert",fname+".frag");
 }
 
+void Shader::loadDeferred(const std::string &fname) {
+	loadDeferred(fname+".vert",fname+".frag");
+}
+
 
 bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool required) {
 	glBindBuffer(GL_ARRAY_BUFFER,id); /// todo: no va type?
@@ -180,11 +215,14 @@ void Shader::setMaterial (const Material &mat) {
 }
 
 Shader::~Shader ( ) {
+	if (pending.vertex_id!=0) glDeleteShader(pending.vertex_id); // never used
+	if (pending.fragment_id!=0) glDeleteShader(pending.fragment_id);
 	if (program_id!=0) glDeleteProgram(program_id);
 }
 
-void Shader::use() const {
+void Shader::use() {
 	cg_assert(program_id!=0,"Shader not initialized");
+	finishLoad();
 	glUseProgram(program_id);
 }
 
@@ -192,6 +230,14 @@ void Shader::setMatrixes (const glm::mat4 &model, const glm::mat4 &view, const g
 	setUniform("modelMatrix",model);
 	setUniform("viewMatrix",view);
 	setUniform("projectionMatrix",projection);
+	// normal matrix: the inverse transpose of view*model, so normals stay
+	// perpendicular to the surface with non-uniform scales; computed here once
+	// per object, instead of once per vertex in the shaders
+	GLint pos = glGetUniformLocation(program_id, "normalMatrix");
+	if (pos!=-1) {
+		glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(view*model)));
+		glUniformMatrix3fv(pos, 1, GL_FALSE, &normal_matrix[0][0]);
+	}
 }
 
 void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
@@ -201,9 +247,10 @@ void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightCol
 }
 
 void Shader::setLightX(int i, const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
-	static char cs_lp[] = "lightPositionX";
-	static char cs_lc[] = "lightColorX";
-	static char cs_as[] = "ambientStrengthX";
+	// local copies (not static), so calls don't share the buffers
+	char cs_lp[] = "lightPositionX";
+	char cs_lc[] = "lightColorX";
+	char cs_as[] = "ambientStrengthX";
 	cs_lp[13] = cs_lc[10] = cs_as[15] = '0'+i;
 	setUniform(cs_lp,lightPosition);
 	setUniform(cs_lc,lightColor);
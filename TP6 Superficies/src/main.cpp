@@ -40,9 +40,10 @@ int main() {
 	glEnable(GL_DEPTH_TEST); glDepthFunc(GL_LESS); 
 	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 	glClearColor(0.8f,0.8f,0.9f,1.f);
-	Shader shader_flat("shaders/flat"),
-	       shader_smooth("shaders/smooth"),
-		   shader_wireframe("shaders/wireframe");
+	Shader shader_flat, shader_smooth, shader_wireframe; // compiled at the same time (see loadDeferred)
+	shader_flat.loadDeferred("shaders/flat");
+	shader_smooth.loadDeferred("shaders/smooth");
+	shader_wireframe.loadDeferred("shaders/wireframe");
 	SubDivMeshRenderer renderer;
 	
 	// main loop
@@ -9,6 +9,7 @@ in vec2 vertexTexCoords;
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform mat3 normalMatrix;
 uniform vec4 lightPosition;
 
 out vec3 fragPosition;
@@ -21,7 +22,7 @@ void main() {
 	vec4 vmp = vm * vec4(vertexPosition,1.f);
 	gl_Position = projectionMatrix * vmp;
 	fragPosition = vec3(vmp);
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
+	fragNormal = normalMatrix * vertexNormal;
 	lightVSPosition = viewMatrix * lightPosition;
 	fragTexCoords = vertexTexCoords;
 }
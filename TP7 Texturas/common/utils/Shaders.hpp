@@ -18,6 +18,13 @@ public:
 	void load(const std::string &fname);
 	void load(const std::string &vertex_fname, const std::string &fragment_fname);
 	
+	// like load, but only submits the shaders to the driver; with
+	// GL_KHR_parallel_shader_compile the programs loaded this way are built
+	// at the same time, and errors are checked when use() is first called
+	void loadDeferred(const std::string &fname);
+	void loadDeferred(const std::string &vertex_fname, const std::string &fragment_fname);
+	bool isReady() const; // false while the driver is still building it
+	
 	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true);
 	void setBuffers(const GeometryRenderer &geo);
 	void setMaterial(const Material &mat);
@@ -32,10 +39,15 @@ public:
 	
 	GLuint getProgramId() const { return program_id; }
 	
-	void use() const;
+	void use();
 	~Shader();
 private:
 	Shader &operator=(const Shader &) = default;
+	void finishLoad();
+	struct PendingLoad { // set by loadDeferred, until finishLoad
+		std::string vertex_fname, fragment_fname;
+		GLuint vertex_id = 0, fragment_id = 0;
+	} pending;
 	GLuint program_id = 0;
 };
 
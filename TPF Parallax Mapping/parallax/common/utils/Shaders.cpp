@@ -3,6 +3,7 @@
 #include <vector>
 #include <iostream>
 #include <glad/glad.h>
+#include <glm/matrix.hpp>
 #include "Shaders.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
@@ -197,6 +198,14 @@ void Shader::setMatrixes (const glm::mat4 &model, const glm::mat4 &view, const g
 	setUniform("modelMatrix",model);
 	setUniform("viewMatrix",view);
 	setUniform("projectionMatrix",projection);
+	// normal matrix: the inverse transpose of view*model, so normals stay
+	// perpendicular to the surface with non-uniform scales; computed here once
+	// per object, instead of once per vertex in the shaders
+	GLint pos = glGetUniformLocation(program_id, "normalMatrix");
+	if (pos!=-1) {
+		glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(view*model)));
+		glUniformMatrix3fv(pos, 1, GL_FALSE, &normal_matrix[0][0]);
+	}
 }
 
 void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {